@@ -0,0 +1,122 @@
+#pragma once
+// Group-by aggregation on top of coalesced_map
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "coalesced_hashtable.hpp"
+
+namespace coalesced_hash {
+
+/** Aggregate state
+ * Default constructible, add folds one input row into the group,
+ * merge folds a partial state of the same group from another table. */
+template<class T>
+struct sum_aggregate {
+    T value{};
+    void add(const T& input) {
+        value += input;
+    }
+    void merge(const sum_aggregate& other) {
+        value += other.value;
+    }
+};
+
+struct count_aggregate {
+    uint64_t value = 0;
+    template<class Input>
+    void add(const Input&) {
+        ++value;
+    }
+    void merge(const count_aggregate& other) {
+        value += other.value;
+    }
+};
+
+/** Group-by aggregator
+ * Rows are upserted with try_emplace (lookup and insert in one chain
+ * walk), batches prefetch home slots of the next rows while the current
+ * ones are folded, parallel aggregation fills one partial table per thread
+ * and merges all of them into this aggregator at the end. */
+template<class Key, class Agg, class Hasher = std::hash<Key>>
+class coalesced_aggregator {
+public:
+    using map_type = coalesced_map<Key, Agg, Hasher>;
+
+    enum { prefetch_distance = 16 };
+
+    explicit coalesced_aggregator(uint32_t expected_groups = 8)
+        : map_(std::max<uint32_t>(expected_groups, 8)) {
+    }
+
+    template<class Input>
+    void add(const Key& key, const Input& input) {
+        map_.try_emplace(key).first->value.second.add(input);
+    }
+
+    template<class Input>
+    void add_batch(const Key* keys, const Input* inputs, size_t count) {
+        auto ahead = std::min<size_t>(prefetch_distance, count);
+        for(size_t i = 0; i < ahead; ++i)
+            map_.prefetch(keys[i]);
+        for(size_t i = 0; i < count; ++i) {
+            if(i + prefetch_distance < count)
+                map_.prefetch(keys[i + prefetch_distance]);
+            add(keys[i], inputs[i]);
+        }
+    }
+
+    void merge(coalesced_aggregator& other) {
+        for(auto iter = other.map_.begin(); iter != other.map_.end(); ++iter)
+            map_.try_emplace(iter->value.first)
+                .first->value.second.merge(iter->value.second);
+    }
+
+    // splits rows into one slice per thread, partial tables are merged
+    // into this one when all threads are done
+    template<class Input>
+    void add_parallel(
+        const Key* keys, const Input* inputs, size_t count, unsigned threads,
+        uint32_t expected_groups = 8) {
+        if(threads == 0)
+            threads = 1;
+        std::vector<std::unique_ptr<coalesced_aggregator>> partials;
+        for(unsigned t = 0; t < threads; ++t)
+            partials.emplace_back(new coalesced_aggregator(expected_groups));
+        auto slice = (count + threads - 1) / threads;
+        auto run = [&](unsigned t) {
+            auto first = std::min(count, slice * t);
+            auto last = std::min(count, first + slice);
+            partials[t]->add_batch(keys + first, inputs + first, last - first);
+        };
+        std::vector<std::thread> workers;
+        for(unsigned t = 1; t < threads; ++t)
+            workers.emplace_back(run, t);
+        run(0);
+        for(auto& worker : workers)
+            worker.join();
+        for(auto& partial : partials)
+            merge(*partial);
+    }
+
+    const Agg* find(const Key& key) {
+        auto iter = map_.find(key);
+        return (iter == map_.end()) ? nullptr : &iter->value.second;
+    }
+
+    size_t size() const {
+        return map_.size();
+    }
+
+    map_type& map() {
+        return map_;
+    }
+
+private:
+    map_type map_;
+};
+
+} // namespace coalesced_hash
@@ -0,0 +1,191 @@
+#pragma once
+// Single writer coalesced map growing on a helper thread
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+
+#include "coalesced_hashtable.hpp"
+
+namespace coalesced_hash {
+
+/** Background rehash
+ * Once load crosses async_load_factor (below max_load_factor of the
+ * table) the table is frozen and a helper thread copies it into a table
+ * of the next capacity. Meanwhile the writer keeps working against the
+ * frozen table plus a change log: inserted elements and copies of frozen
+ * elements looked up for writing go into a small delta table, erased keys
+ * of the frozen table into an erased set. When the helper is done the
+ * next operation replays the log into the new table and switches over,
+ * the writer never waits for a full table copy.
+ * Only the owning thread may call members; the helper thread only reads
+ * the frozen table. T has to be copy constructible. */
+template<
+    class Key, class T, class Hasher = std::hash<Key>,
+    class KeyEq = std::equal_to<Key>>
+class coalesced_async_map {
+public:
+    using key_type = Key;
+    using mapped_type = T;
+    using value_type = std::pair<const Key, T>;
+    using map_type = coalesced_map<Key, T, Hasher, KeyEq>;
+
+    explicit coalesced_async_map(
+        uint32_t size, double async_load_factor = 0.75)
+        : active_(new map_type(size))
+        , async_load_factor_(async_load_factor) {
+    }
+    coalesced_async_map(const coalesced_async_map&) = delete;
+    ~coalesced_async_map() {
+        if(helper_.joinable())
+            helper_.join();
+    }
+
+    // inserts unless key is present, returns true when inserted
+    bool insert(value_type&& data) {
+        poll();
+        if(!rehashing()) {
+            if(double(active_->size() + 1)
+               > async_load_factor_ * active_->bucket_count()) {
+                start_rehash_();
+            }
+            else {
+                return active_->try_emplace(
+                                  data.first, std::move(data.second))
+                    .second;
+            }
+        }
+        if(static_cast<const coalesced_async_map&>(*this).find(data.first)
+           != nullptr)
+            return false;
+        // an erased frozen element stays erased, delta shadows it
+        delta_->try_emplace(data.first, std::move(data.second));
+        ++size_;
+        return true;
+    }
+
+    // mutable access, during a rehash a frozen element is copied into the
+    // delta table first, so writes never touch the table being copied;
+    // the pointer is valid until the next non-const call
+    [[nodiscard]] T* find(const key_type& key) {
+        poll();
+        if(!rehashing())
+            return value_(*active_, key);
+        if(auto value = value_(*delta_, key))
+            return value;
+        auto frozen = find_frozen_(key);
+        if(frozen == nullptr)
+            return nullptr;
+        return &delta_->try_emplace(key, *frozen).first->value.second;
+    }
+
+    [[nodiscard]] const T* find(const key_type& key) const {
+        if(!rehashing())
+            return value_(*active_, key);
+        if(auto value = value_(*delta_, key))
+            return value;
+        return find_frozen_(key);
+    }
+
+    size_t erase(const key_type& key) {
+        poll();
+        if(!rehashing())
+            return active_->erase(key);
+        // delta may hold a copy of a frozen element, that one goes too
+        auto erased = delta_->erase(key);
+        if(find_frozen_(key) != nullptr) {
+            erased_->try_emplace(key, true);
+            erased = 1;
+        }
+        size_ -= erased;
+        return erased;
+    }
+
+    size_t size() const {
+        return rehashing() ? size_ : active_->size();
+    }
+
+    bool rehashing() const {
+        return (frozen_ != nullptr);
+    }
+
+    // switches over to the new table when the helper thread is done
+    void poll() {
+        if(rehashing() && ready_.load(std::memory_order_acquire))
+            finish_rehash_();
+    }
+
+    // blocks until a running background rehash is switched over
+    void wait() {
+        if(rehashing())
+            finish_rehash_();
+    }
+
+    size_t bucket_count() const {
+        return rehashing() ? next_->bucket_count() : active_->bucket_count();
+    }
+
+private:
+    // element of the frozen table unless erased during the rehash
+    const T* find_frozen_(const key_type& key) const {
+        if(erased_->find(key) != erased_->end())
+            return nullptr;
+        return value_(*frozen_, key);
+    }
+
+    static T* value_(map_type& map, const key_type& key) {
+        auto iter = map.find(key);
+        return (iter == map.end()) ? nullptr : &iter->value.second;
+    }
+
+    void start_rehash_() {
+        size_ = active_->size();
+        frozen_ = std::move(active_);
+        next_.reset(new map_type(frozen_->bucket_count() * 2));
+        delta_.reset(new map_type(min_buckets_));
+        erased_.reset(new erased_set_(min_buckets_));
+        ready_.store(false, std::memory_order_relaxed);
+        helper_ = std::thread([this]() {
+            auto& frozen = *frozen_;
+            auto& next = *next_;
+            for(auto iter = frozen.begin(); iter != frozen.end(); ++iter)
+                next.insert({iter->value.first, iter->value.second});
+            ready_.store(true, std::memory_order_release);
+        });
+    }
+
+    // replays the change log into the new table
+    void finish_rehash_() {
+        helper_.join();
+        for(auto iter = erased_->begin(); iter != erased_->end(); ++iter)
+            next_->erase(iter->value.first);
+        // delta holds new elements and updated copies of frozen ones
+        for(auto iter = delta_->begin(); iter != delta_->end(); ++iter) {
+            auto result = next_->try_emplace(
+                iter->value.first, std::move(iter->value.second));
+            if(!result.second)
+                result.first->value.second = std::move(iter->value.second);
+        }
+        active_ = std::move(next_);
+        frozen_.reset();
+        delta_.reset();
+        erased_.reset();
+    }
+
+    using erased_set_ = coalesced_map<Key, bool, Hasher, KeyEq>;
+    static constexpr uint32_t min_buckets_ = 8;
+
+    std::unique_ptr<map_type> active_;
+    std::unique_ptr<map_type> frozen_;
+    std::unique_ptr<map_type> next_;
+    std::unique_ptr<map_type> delta_;
+    std::unique_ptr<erased_set_> erased_;
+    std::thread helper_;
+    std::atomic<bool> ready_{false};
+    double async_load_factor_;
+    size_t size_ = 0;
+};
+
+} // namespace coalesced_hash
@@ -0,0 +1,72 @@
+// Group-by aggregation: coalesced_aggregator against a naive
+// std::unordered_map loop on the same rows
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "coalesced_aggregator.hpp"
+
+namespace {
+
+template<class F>
+double time_ms(F f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+} // namespace
+
+// usage: coalesced_bench [rows] [groups]
+int main(int argc, char** argv) {
+    size_t rows = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+    uint32_t groups =
+        (argc > 2) ? uint32_t(std::strtoul(argv[2], nullptr, 10)) : 100000;
+    std::mt19937_64 random(42);
+    std::vector<uint32_t> keys(rows);
+    std::vector<int64_t> values(rows);
+    for(size_t i = 0; i < rows; ++i) {
+        keys[i] = uint32_t(random() % groups);
+        values[i] = int64_t(random() % 1000);
+    }
+
+    using sum_t = coalesced_hash::sum_aggregate<int64_t>;
+    // both sides are told the group count up front
+    std::unordered_map<uint32_t, int64_t> naive;
+    naive.reserve(groups);
+    auto naive_ms = time_ms([&] {
+        for(size_t i = 0; i < rows; ++i)
+            naive[keys[i]] += values[i];
+    });
+    coalesced_hash::coalesced_aggregator<uint32_t, sum_t> serial(groups);
+    auto serial_ms = time_ms(
+        [&] { serial.add_batch(keys.data(), values.data(), rows); });
+    auto threads = std::max(1u, std::thread::hardware_concurrency());
+    coalesced_hash::coalesced_aggregator<uint32_t, sum_t> parallel(groups);
+    auto parallel_ms = time_ms([&] {
+        parallel.add_parallel(
+            keys.data(), values.data(), rows, threads, groups);
+    });
+
+    // same groups and sums in every table
+    bool same = serial.size() == naive.size()
+        && parallel.size() == naive.size();
+    for(auto& [key, sum] : naive) {
+        same = same && serial.find(key)->value == sum
+            && parallel.find(key)->value == sum;
+    }
+    std::printf("rows %zu, groups %zu\n", rows, naive.size());
+    std::printf("std::unordered_map loop   %9.1f ms\n", naive_ms);
+    std::printf("coalesced_aggregator      %9.1f ms\n", serial_ms);
+    std::printf(
+        "coalesced_aggregator x%-3u %9.1f ms\n", threads, parallel_ms);
+    return same ? 0 : 1;
+}
@@ -0,0 +1,312 @@
+#pragma once
+// Compressed table images with block parallel decompression
+
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "coalesced_hashtable.hpp"
+
+namespace coalesced_hash {
+
+namespace ch_codec {
+
+inline void put_varint(std::vector<uint8_t>& out, uint64_t value) {
+    while(value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+inline bool get_varint(
+    const uint8_t*& in, const uint8_t* end, uint64_t& value) {
+    value = 0;
+    for(uint32_t shift = 0; shift < 64; shift += 7) {
+        if(in == end)
+            return false;
+        auto byte = *in++;
+        value |= uint64_t(byte & 0x7F) << shift;
+        if(0 == (byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+inline uint64_t zigzag(int64_t value) {
+    return (uint64_t(value) << 1) ^ uint64_t(value >> 63);
+}
+
+inline int64_t unzigzag(uint64_t value) {
+    return int64_t(value >> 1) ^ -int64_t(value & 1);
+}
+
+inline uint32_t read32(const uint8_t* ptr) {
+    uint32_t value;
+    std::memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+/** LZ codec
+ * Byte oriented LZ77: sequences of [literal count][literals][match length]
+ * [16-bit offset], lengths as varints, match length 0 ends a sequence
+ * without match. Matches are found through a 4 byte hash table. */
+inline void lz_compress(
+    const uint8_t* src, size_t size, std::vector<uint8_t>& out) {
+    enum : uint32_t { hash_bits = 12, min_match = 4, max_offset = 0xFFFF };
+    std::vector<uint32_t> table(size_t(1) << hash_bits, UINT32_MAX);
+    size_t anchor = 0;
+    size_t pos = 0;
+    auto emit = [&](size_t match_pos, size_t length) {
+        put_varint(out, pos - anchor);
+        out.insert(out.end(), src + anchor, src + pos);
+        put_varint(out, length);
+        if(length != 0) {
+            auto offset = static_cast<uint16_t>(pos - match_pos);
+            out.push_back(static_cast<uint8_t>(offset));
+            out.push_back(static_cast<uint8_t>(offset >> 8));
+        }
+    };
+    while(pos + min_match <= size) {
+        auto word = read32(src + pos);
+        auto hash = (word * 2654435761u) >> (32 - hash_bits);
+        auto candidate = table[hash];
+        table[hash] = static_cast<uint32_t>(pos);
+        if(candidate == UINT32_MAX || pos - candidate > max_offset
+           || read32(src + candidate) != word) {
+            ++pos;
+            continue;
+        }
+        size_t length = min_match;
+        while(pos + length < size
+              && src[candidate + length] == src[pos + length])
+            ++length;
+        emit(candidate, length);
+        pos += length;
+        anchor = pos;
+    }
+    pos = size;
+    emit(0, 0);
+}
+
+// false when src is malformed or does not decode to exactly size bytes
+inline bool lz_decompress(
+    const uint8_t* src, size_t src_size, uint8_t* dst, size_t size) {
+    auto in = src;
+    auto end = src + src_size;
+    size_t pos = 0;
+    while(in != end) {
+        uint64_t literals = 0;
+        uint64_t length = 0;
+        if(!get_varint(in, end, literals) || literals > size_t(end - in)
+           || literals > size - pos)
+            return false;
+        std::memcpy(dst + pos, in, literals);
+        in += literals;
+        pos += literals;
+        if(!get_varint(in, end, length))
+            return false;
+        if(length == 0)
+            continue;
+        if(end - in < 2)
+            return false;
+        size_t offset = in[0] | (size_t(in[1]) << 8);
+        in += 2;
+        if(offset == 0 || offset > pos || length > size - pos)
+            return false;
+        // overlapping copy, byte by byte
+        for(uint64_t i = 0; i < length; ++i, ++pos)
+            dst[pos] = dst[pos - offset];
+    }
+    return pos == size;
+}
+
+} // namespace ch_codec
+
+/** Compressed image
+ * Raw image (save_image) split into blocks of block_nodes nodes, every
+ * block compressed on its own so blocks decode in parallel. With address
+ * headers links are stored as a flag byte plus zigzag varint deltas to the
+ * slot index (empty slots cost one byte), the rest of the nodes goes
+ * through the LZ codec together with the link stream.
+ * Layout: magic, block_nodes, block count, image header, block sizes,
+ * blocks. */
+struct ch_compressed_header_t {
+    uint32_t magic;
+    uint32_t block_nodes;
+    uint32_t block_count;
+    uint32_t reserved;
+    ch_image_header_t image;
+};
+
+constexpr uint32_t ch_compressed_magic = 0x315A4843; // "CHZ1"
+
+template<class Map>
+void save_compressed(
+    Map& map, std::ostream& out, uint32_t block_nodes = 4096) {
+    constexpr bool address_links =
+        std::is_same_v<typename Map::header_traits, address_node_traits>;
+    std::ostringstream raw_stream;
+    map.save_image(raw_stream);
+    auto raw = raw_stream.str();
+    ch_compressed_header_t header{};
+    std::memcpy(&header.image, raw.data(), sizeof(header.image));
+    auto node_size = header.image.node_size;
+    auto nodes = uint64_t(header.image.capacity) + 1;
+    header.magic = ch_compressed_magic;
+    header.block_nodes = block_nodes;
+    header.block_count =
+        static_cast<uint32_t>((nodes + block_nodes - 1) / block_nodes);
+    auto table = reinterpret_cast<const uint8_t*>(raw.data())
+        + sizeof(ch_image_header_t);
+    std::vector<std::vector<uint8_t>> blocks(header.block_count);
+    std::vector<uint8_t> stream;
+    for(uint32_t b = 0; b < header.block_count; ++b) {
+        auto first = uint64_t(b) * block_nodes;
+        auto last = std::min(nodes, first + block_nodes);
+        stream.clear();
+        size_t skip = 0;
+        if constexpr(address_links) {
+            skip = sizeof(address_node_t);
+            for(auto slot = first; slot < last; ++slot) {
+                address_node_t links;
+                std::memcpy(&links, table + slot * node_size, sizeof(links));
+                uint8_t flags = static_cast<uint8_t>(
+                    (links.prev & address_node_traits::all) >> 28);
+                bool has_links = (links.prev & ~address_node_traits::all) != 0
+                    || links.next != 0;
+                stream.push_back(flags | (has_links ? 0x10 : 0));
+                if(!has_links)
+                    continue;
+                ch_codec::put_varint(
+                    stream,
+                    ch_codec::zigzag(
+                        int64_t(links.prev & ~address_node_traits::all)
+                        - int64_t(slot)));
+                ch_codec::put_varint(
+                    stream,
+                    ch_codec::zigzag(int64_t(links.next) - int64_t(slot)));
+            }
+        }
+        for(auto slot = first; slot < last; ++slot)
+            stream.insert(
+                stream.end(), table + slot * node_size + skip,
+                table + (slot + 1) * node_size);
+        auto& block = blocks[b];
+        ch_codec::put_varint(block, stream.size());
+        ch_codec::lz_compress(stream.data(), stream.size(), block);
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for(auto& block : blocks) {
+        auto size = static_cast<uint32_t>(block.size());
+        out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    }
+    for(auto& block : blocks)
+        out.write(
+            reinterpret_cast<const char*>(block.data()),
+            std::streamsize(block.size()));
+}
+
+// decodes blocks on threads workers and loads the image into map
+template<class Map>
+bool load_compressed(
+    Map& map, const void* data, size_t size, unsigned threads = 1,
+    uint64_t* log_sequence = nullptr) {
+    constexpr bool address_links =
+        std::is_same_v<typename Map::header_traits, address_node_traits>;
+    auto bytes = static_cast<const uint8_t*>(data);
+    ch_compressed_header_t header;
+    if(size < sizeof(header))
+        return false;
+    std::memcpy(&header, bytes, sizeof(header));
+    auto node_size = header.image.node_size;
+    auto nodes = uint64_t(header.image.capacity) + 1;
+    if(header.magic != ch_compressed_magic || header.block_nodes == 0
+       || !ch_image_compatible(header.image, Map::image_signature())
+       || (address_links && node_size < sizeof(address_node_t))
+       || header.block_count != (nodes + header.block_nodes - 1)
+               / header.block_nodes
+       || size - sizeof(header) < uint64_t(header.block_count) * 4)
+        return false;
+    std::vector<uint64_t> offsets(header.block_count + 1);
+    offsets[0] = sizeof(header) + uint64_t(header.block_count) * 4;
+    for(uint32_t b = 0; b < header.block_count; ++b) {
+        uint32_t block_size;
+        std::memcpy(
+            &block_size, bytes + sizeof(header) + uint64_t(b) * 4,
+            sizeof(block_size));
+        offsets[b + 1] = offsets[b] + block_size;
+    }
+    if(offsets.back() != size)
+        return false;
+    std::vector<uint8_t> raw(sizeof(ch_image_header_t) + nodes * node_size);
+    std::memcpy(raw.data(), &header.image, sizeof(ch_image_header_t));
+    auto table = raw.data() + sizeof(ch_image_header_t);
+    std::vector<uint8_t> failed(header.block_count, 0);
+    auto decode = [&](uint32_t b) {
+        auto in = bytes + offsets[b];
+        auto end = bytes + offsets[b + 1];
+        auto first = uint64_t(b) * header.block_nodes;
+        auto last = std::min(nodes, first + header.block_nodes);
+        uint64_t stream_size = 0;
+        if(!ch_codec::get_varint(in, end, stream_size)
+           || stream_size > (last - first) * (node_size + 21))
+            return false;
+        std::vector<uint8_t> stream(stream_size);
+        if(!ch_codec::lz_decompress(in, end - in, stream.data(), stream_size))
+            return false;
+        const uint8_t* pos = stream.data();
+        const uint8_t* stream_end = pos + stream_size;
+        size_t skip = 0;
+        if constexpr(address_links) {
+            skip = sizeof(address_node_t);
+            for(auto slot = first; slot < last; ++slot) {
+                if(pos == stream_end)
+                    return false;
+                auto flags = *pos++;
+                address_node_t links{uint32_t(flags & 0x0F) << 28, 0};
+                if(flags & 0x10) {
+                    uint64_t prev = 0;
+                    uint64_t next = 0;
+                    if(!ch_codec::get_varint(pos, stream_end, prev)
+                       || !ch_codec::get_varint(pos, stream_end, next))
+                        return false;
+                    links.prev |= static_cast<uint32_t>(
+                        ch_codec::unzigzag(prev) + int64_t(slot));
+                    links.next = static_cast<uint32_t>(
+                        ch_codec::unzigzag(next) + int64_t(slot));
+                }
+                std::memcpy(table + slot * node_size, &links, sizeof(links));
+            }
+        }
+        auto payload = node_size - skip;
+        if(uint64_t(stream_end - pos) != (last - first) * payload)
+            return false;
+        for(auto slot = first; slot < last; ++slot, pos += payload)
+            std::memcpy(table + slot * node_size + skip, pos, payload);
+        return true;
+    };
+    if(threads == 0)
+        threads = 1;
+    auto run = [&](unsigned t) {
+        for(uint32_t b = t; b < header.block_count; b += threads)
+            failed[b] = !decode(b);
+    };
+    std::vector<std::thread> workers;
+    for(unsigned t = 1; t < threads; ++t)
+        workers.emplace_back(run, t);
+    run(0);
+    for(auto& worker : workers)
+        worker.join();
+    for(auto fail : failed)
+        if(fail)
+            return false;
+    return map.load_image(raw.data(), raw.size(), log_sequence);
+}
+
+} // namespace coalesced_hash
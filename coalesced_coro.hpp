@@ -0,0 +1,133 @@
+#pragma once
+// Coroutine interleaved lookups on top of coalesced_map (C++20)
+
+#if defined(__cpp_impl_coroutine)
+
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <utility>
+
+#include "coalesced_hashtable.hpp"
+
+namespace coalesced_hash {
+
+// client coroutine run by coalesced_scheduler
+class coalesced_task {
+public:
+    struct promise_type {
+        coalesced_task get_return_object() {
+            return coalesced_task(
+                std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept {
+            return {};
+        }
+        std::suspend_always final_suspend() noexcept {
+            return {};
+        }
+        void return_void() {
+        }
+        void unhandled_exception() {
+            std::terminate();
+        }
+    };
+
+    coalesced_task(coalesced_task&& other) noexcept
+        : handle_(std::exchange(other.handle_, nullptr)) {
+    }
+    coalesced_task(const coalesced_task&) = delete;
+    ~coalesced_task() {
+        if(handle_)
+            handle_.destroy();
+    }
+
+    std::coroutine_handle<> release() {
+        return std::exchange(handle_, nullptr);
+    }
+
+private:
+    explicit coalesced_task(std::coroutine_handle<promise_type> handle)
+        : handle_(handle) {
+    }
+
+    std::coroutine_handle<promise_type> handle_;
+};
+
+/** Lookup scheduler
+ * Round-robins suspended lookups: every turn advances one pending lookup
+ * by a single chain hop (which prefetches the next node) and resumes the
+ * coroutine once its lookup is done, so with N tasks in flight each hop
+ * has N-1 other hops to hide its cache miss behind. */
+class coalesced_scheduler {
+public:
+    coalesced_scheduler() = default;
+    coalesced_scheduler(const coalesced_scheduler&) = delete;
+    ~coalesced_scheduler() {
+        // unfinished coroutines are owned by the scheduler
+        for(auto& entry : queue_)
+            entry.handle.destroy();
+    }
+
+    void spawn(coalesced_task task) {
+        post(task.release(), nullptr, nullptr);
+    }
+
+    // step returns true when the awaited operation is complete
+    void post(
+        std::coroutine_handle<> handle, bool (*step)(void*), void* state) {
+        queue_.push_back(entry_{handle, step, state});
+    }
+
+    void run() {
+        while(!queue_.empty()) {
+            auto entry = queue_.front();
+            queue_.pop_front();
+            if(entry.step != nullptr && !entry.step(entry.state)) {
+                queue_.push_back(entry);
+                continue;
+            }
+            entry.handle.resume();
+            if(entry.handle.done())
+                entry.handle.destroy();
+        }
+    }
+
+    // awaitable lookup, co_await yields the iterator of map.find(key)
+    template<class Map, class Key>
+    auto find(Map& map, const Key& key) {
+        struct awaiter {
+            coalesced_scheduler& scheduler;
+            Map& map;
+            typename Map::find_state state;
+
+            bool await_ready() {
+                return false;
+            }
+            void await_suspend(std::coroutine_handle<> handle) {
+                scheduler.post(handle, &step, this);
+            }
+            auto await_resume() {
+                return map.find_result(state);
+            }
+            static bool step(void* self) {
+                auto lookup = static_cast<awaiter*>(self);
+                return lookup->map.find_step(lookup->state);
+            }
+        };
+        return awaiter{*this, map, map.find_begin(key)};
+    }
+
+private:
+    struct entry_ {
+        std::coroutine_handle<> handle;
+        bool (*step)(void*);
+        void* state;
+    };
+
+    std::deque<entry_> queue_;
+};
+
+} // namespace coalesced_hash
+
+#endif // __cpp_impl_coroutine
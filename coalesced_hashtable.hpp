@@ -4,26 +4,79 @@
 // Based on Jeffrey Scott Vitter article
 // https://www.researchgate.net/publication/220424188_Implementations_for_Coalesced_Hashing
 
+#include <algorithm>
+#include <chrono>
 #include <cstdint>
+#include <cstring>
+#include <istream>
 #include <memory>
+#include <ostream>
+#include <thread>
+#include <tuple>
 #include <type_traits>
+#include <utility>
+#include <vector>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
 // clang-format on
 
 namespace coalesced_hash {
 
+// chain linking shared by node headers, Traits provides flag and link access
+template<class Traits>
+struct address_link_ops {
+    template<class Node>
+    static inline bool is_intermediate(Node* x) {
+        return (!Traits::is_head(x) && !Traits::is_tail(x));
+    }
+    // links n behind p, singly linked n takes over p's successor
+    template<class Node>
+    static inline void link_(Node* n, Node* p, uint32_t n_pos, uint32_t p_pos) {
+        Traits::set_allocated(n);
+        Traits::set_allocated(p);
+        if constexpr(Traits::doubly_linked) {
+            Traits::set_next(p, n_pos);
+            Traits::set_prev(n, p_pos);
+        }
+        else {
+            Traits::set_next(n, Traits::next(p));
+            Traits::set_next(p, n_pos);
+        }
+        if(Traits::is_tail(p))
+            Traits::reset_tail(p);
+        Traits::set_tail(n);
+    }
+    template<class Node>
+    static inline void link_head(Node* x, uint32_t pos) {
+        link_(x, x, pos, pos);
+        Traits::set_head(x);
+        Traits::set_tail(x);
+    }
+};
+
 struct address_node_t {
     uint32_t prev = 0;
     uint32_t next = 0;
 };
 
-struct address_node_traits {
+struct address_node_traits : address_link_ops<address_node_traits> {
     using node_type = address_node_t;
     enum {
         tail_flag = 0x80000000,
         head_flag = 0x40000000,
         allocated_flag = 0x20000000,
-        all = 0xE0000000
+        erased_flag = 0x10000000,
+        all = 0xF0000000
     };
+    static constexpr bool doubly_linked = true;
+    // sentinel slot index (capacity) has to fit into a link
+    static constexpr uint32_t max_capacity = ~uint32_t(all);
+
+    static inline void clear(node_type* x) {
+        x->prev = 0;
+        x->next = 0;
+    }
     static inline uint32_t next(node_type* x) {
         return x->next;
     }
@@ -45,43 +98,185 @@ struct address_node_traits {
     static inline void set_allocated(node_type* x) {
         x->prev |= allocated_flag;
     }
+    static inline void set_erased(node_type* x) {
+        x->prev |= erased_flag;
+    }
     static inline bool is_tail(node_type* x) {
         return 0 != (x->prev & tail_flag);
     }
     static inline bool is_head(node_type* x) {
         return 0 != (x->prev & head_flag);
     }
-    static inline bool is_intermediate(node_type* x) {
-        return (!is_head(x) && !is_tail(x));
-    }
     static inline bool is_allocated(node_type* x) {
         return 0 != (x->prev & allocated_flag);
     }
+    static inline bool is_erased(node_type* x) {
+        return 0 != (x->prev & erased_flag);
+    }
     static inline void reset_flags(node_type* x) {
         x->prev &= ~all;
     }
     static inline void reset_tail(node_type* x) {
         x->prev &= ~tail_flag;
     }
-    static inline void link_(
-        node_type* n, node_type* p, uint32_t n_pos, uint32_t p_pos) {
-        set_allocated(n);
-        set_allocated(p);
-        set_next(p, n_pos);
-        set_prev(n, p_pos);
-        if(is_tail(p))
-            reset_tail(p);
-        set_tail(n);
-    }
-    static inline void link_head(node_type* x, uint32_t pos) {
-        link_(x, x, pos, pos);
-        set_head(x);
-        set_tail(x);
+    static inline void reset_head(node_type* x) {
+        x->prev &= ~head_flag;
     }
 };
 
-template<class Key, class T>
-struct ch_node_t : address_node_t {
+/** Packed node header
+ * 6 bytes aligned to 2: two 22 bit links and four flags in 48 bits.
+ * Table capacity is limited to 4M slots. Pays off for small keys and
+ * values with alignment below 4, where address_node_t header would take
+ * more space than the payload. */
+struct packed_address_node_t {
+    uint16_t bits[3] = {0, 0, 0};
+};
+
+struct packed_address_node_traits
+    : address_link_ops<packed_address_node_traits> {
+    using node_type = packed_address_node_t;
+    enum : uint64_t {
+        link_bits = 22,
+        link_mask = (uint64_t(1) << link_bits) - 1,
+        prev_shift = link_bits,
+        tail_flag = uint64_t(1) << 44,
+        head_flag = uint64_t(1) << 45,
+        allocated_flag = uint64_t(1) << 46,
+        erased_flag = uint64_t(1) << 47,
+        all = tail_flag | head_flag | allocated_flag | erased_flag
+    };
+    static constexpr bool doubly_linked = true;
+    static constexpr uint32_t max_capacity = uint32_t(link_mask);
+
+    static inline uint64_t load(const node_type* x) {
+        return uint64_t(x->bits[0]) | (uint64_t(x->bits[1]) << 16)
+            | (uint64_t(x->bits[2]) << 32);
+    }
+    static inline void store(node_type* x, uint64_t v) {
+        x->bits[0] = static_cast<uint16_t>(v);
+        x->bits[1] = static_cast<uint16_t>(v >> 16);
+        x->bits[2] = static_cast<uint16_t>(v >> 32);
+    }
+    static inline void clear(node_type* x) {
+        store(x, 0);
+    }
+    static inline uint32_t next(node_type* x) {
+        return static_cast<uint32_t>(load(x) & link_mask);
+    }
+    static inline uint32_t prev(node_type* x) {
+        return static_cast<uint32_t>((load(x) >> prev_shift) & link_mask);
+    }
+    static inline void set_next(node_type* x, uint32_t pos) {
+        store(x, (load(x) & ~uint64_t(link_mask)) | pos);
+    }
+    static inline void set_prev(node_type* x, uint32_t pos) {
+        store(
+            x, (load(x) & ~(uint64_t(link_mask) << prev_shift))
+                | (uint64_t(pos) << prev_shift));
+    }
+    static inline void set_tail(node_type* x) {
+        store(x, load(x) | tail_flag);
+    }
+    static inline void set_head(node_type* x) {
+        store(x, load(x) | head_flag);
+    }
+    static inline void set_allocated(node_type* x) {
+        store(x, load(x) | allocated_flag);
+    }
+    static inline void set_erased(node_type* x) {
+        store(x, load(x) | erased_flag);
+    }
+    static inline bool is_tail(node_type* x) {
+        return 0 != (load(x) & tail_flag);
+    }
+    static inline bool is_head(node_type* x) {
+        return 0 != (load(x) & head_flag);
+    }
+    static inline bool is_allocated(node_type* x) {
+        return 0 != (load(x) & allocated_flag);
+    }
+    static inline bool is_erased(node_type* x) {
+        return 0 != (load(x) & erased_flag);
+    }
+    static inline void reset_flags(node_type* x) {
+        store(x, load(x) & ~uint64_t(all));
+    }
+    static inline void reset_tail(node_type* x) {
+        store(x, load(x) & ~uint64_t(tail_flag));
+    }
+    static inline void reset_head(node_type* x) {
+        store(x, load(x) & ~uint64_t(head_flag));
+    }
+};
+
+/** Singly linked node header
+ * Only next link and flags, 4 bytes. There is no list of all elements:
+ * iteration goes in slot order and tail of a chain links back to the
+ * chain head, so erase can find the start of a chain from any node. */
+struct singly_address_node_t {
+    uint32_t next = 0;
+};
+
+struct singly_address_node_traits
+    : address_link_ops<singly_address_node_traits> {
+    using node_type = singly_address_node_t;
+    enum : uint32_t {
+        tail_flag = 0x80000000,
+        head_flag = 0x40000000,
+        allocated_flag = 0x20000000,
+        erased_flag = 0x10000000,
+        all = 0xF0000000
+    };
+    static constexpr bool doubly_linked = false;
+    static constexpr uint32_t max_capacity = ~uint32_t(all);
+
+    static inline void clear(node_type* x) {
+        x->next = 0;
+    }
+    static inline uint32_t next(node_type* x) {
+        return x->next & ~all;
+    }
+    static inline void set_next(node_type* x, uint32_t pos) {
+        x->next = pos | (x->next & all);
+    }
+    static inline void set_tail(node_type* x) {
+        x->next |= tail_flag;
+    }
+    static inline void set_head(node_type* x) {
+        x->next |= head_flag;
+    }
+    static inline void set_allocated(node_type* x) {
+        x->next |= allocated_flag;
+    }
+    static inline void set_erased(node_type* x) {
+        x->next |= erased_flag;
+    }
+    static inline bool is_tail(node_type* x) {
+        return 0 != (x->next & tail_flag);
+    }
+    static inline bool is_head(node_type* x) {
+        return 0 != (x->next & head_flag);
+    }
+    static inline bool is_allocated(node_type* x) {
+        return 0 != (x->next & allocated_flag);
+    }
+    static inline bool is_erased(node_type* x) {
+        return 0 != (x->next & erased_flag);
+    }
+    static inline void reset_flags(node_type* x) {
+        x->next &= ~all;
+    }
+    static inline void reset_tail(node_type* x) {
+        x->next &= ~tail_flag;
+    }
+    static inline void reset_head(node_type* x) {
+        x->next &= ~head_flag;
+    }
+};
+
+template<class Key, class T, class Header = address_node_t>
+struct ch_node_t : Header {
     using value_type = std::pair<const Key, T>;
     template<class... Args>
     ch_node_t(Args&&... args) : value(std::forward<Args>(args)...) {
@@ -90,9 +285,10 @@ struct ch_node_t : address_node_t {
 };
 
 // TODO: move allocator rebind to traits?
-template<class Key, class T>
-struct ch_node_traits : address_node_traits {
-    using node_type = ch_node_t<Key, T>;
+template<class Key, class T, class HeaderTraits = address_node_traits>
+struct ch_node_traits : HeaderTraits {
+    using header_traits = HeaderTraits;
+    using node_type = ch_node_t<Key, T, typename HeaderTraits::node_type>;
     using key_type = Key;
     using mapped_type = T;
     using value_type = std::pair<const Key, T>;
@@ -110,6 +306,200 @@ struct ch_node_traits : address_node_traits {
     }
 };
 
+// key only node, mapped value lives in a parallel array of the storage
+template<class Key, class Header = address_node_t>
+struct ch_key_node_t : Header {
+    template<class... Args>
+    ch_key_node_t(Args&&... args) : key(std::forward<Args>(args)...) {
+    }
+    Key key;
+};
+
+template<class Key, class T, class HeaderTraits = address_node_traits>
+struct ch_key_node_traits : HeaderTraits {
+    using header_traits = HeaderTraits;
+    using node_type = ch_key_node_t<Key, typename HeaderTraits::node_type>;
+    using key_type = Key;
+    using mapped_type = T;
+    using value_type = std::pair<const Key, T>;
+
+    static const key_type& key(const node_type* node) {
+        return (node->key);
+    }
+
+    static const key_type& key(const value_type& data) {
+        return (data.first);
+    }
+};
+
+// element reference handed out by iterators of split storage
+template<class Key, class T>
+struct ch_split_ref_t {
+    std::pair<const Key&, T&> value;
+
+    ch_split_ref_t* operator->() {
+        return this;
+    }
+};
+
+// in place construction arguments of mapped value (try_emplace)
+template<class Key, class... Args>
+struct ch_emplace_t {
+    const Key& key;
+    std::tuple<Args&&...> args;
+};
+
+// key plus index of mapped value in ch_value_pool_t
+template<class Key, class Header = address_node_t>
+struct ch_pool_node_t : Header {
+    static constexpr uint32_t npos = UINT32_MAX;
+    ch_pool_node_t() = default;
+    template<class K>
+    ch_pool_node_t(K&& k, uint32_t index)
+        : key(std::forward<K>(k)), value_index(index) {
+    }
+    Key key{};
+    uint32_t value_index = npos;
+};
+
+// node content moved between pooled tables, mapped value stays in place
+template<class Key>
+struct ch_pool_handle_t {
+    Key key;
+    uint32_t index;
+};
+
+template<class Key, class T, class HeaderTraits = address_node_traits>
+struct ch_pool_node_traits : HeaderTraits {
+    using header_traits = HeaderTraits;
+    using node_type = ch_pool_node_t<Key, typename HeaderTraits::node_type>;
+    using key_type = Key;
+    using mapped_type = T;
+    using value_type = std::pair<const Key, T>;
+
+    static const key_type& key(const node_type* node) {
+        return (node->key);
+    }
+
+    static const key_type& key(const value_type& data) {
+        return (data.first);
+    }
+};
+
+/** Integer key node
+ * Key and mapped value as plain members right behind the header, no
+ * pair: behind a 4 byte singly linked header a 32-bit key fills the gap
+ * before an 8 byte aligned value. Empty slots are told by the allocated
+ * flag of the header, no key value is reserved. */
+template<class Key, class T, class Header = singly_address_node_t>
+struct ch_int_node_t : Header {
+    ch_int_node_t() : key(), mapped() {
+    }
+    // constrained so copies of nodes still take the copy constructor
+    template<
+        class Pair,
+        class = std::enable_if_t<
+            !std::is_same_v<std::decay_t<Pair>, ch_int_node_t>>>
+    ch_int_node_t(Pair&& data)
+        : key(data.first), mapped(std::forward<Pair>(data).second) {
+    }
+    template<class KeyArgs, class Args>
+    ch_int_node_t(std::piecewise_construct_t, KeyArgs&& key_args, Args&& args)
+        : key(std::get<0>(key_args))
+        , mapped(std::make_from_tuple<T>(std::forward<Args>(args))) {
+    }
+    Key key;
+    T mapped;
+};
+
+template<class Key, class T, class HeaderTraits = singly_address_node_traits>
+struct ch_int_node_traits : HeaderTraits {
+    using header_traits = HeaderTraits;
+    using node_type = ch_int_node_t<Key, T, typename HeaderTraits::node_type>;
+    using key_type = Key;
+    using mapped_type = T;
+    using value_type = std::pair<const Key, T>;
+
+    static const key_type& key(const node_type* node) {
+        return (node->key);
+    }
+
+    static const key_type& key(const value_type& data) {
+        return (data.first);
+    }
+};
+
+/** Value pool
+ * Chunked storage with free list, elements are never moved so references
+ * and addresses stay valid until the element is erased. Elements are
+ * destroyed by the owner, pool only releases chunk memory. */
+template<class T, class Alloc>
+class ch_value_pool_t {
+    using allocator_t =
+        typename std::allocator_traits<Alloc>::template rebind_alloc<T>;
+    using allocator_traits = std::allocator_traits<allocator_t>;
+
+public:
+    enum : uint32_t {
+        chunk_bits = 8,
+        chunk_size = 1u << chunk_bits,
+        chunk_mask = chunk_size - 1
+    };
+
+    ch_value_pool_t() = default;
+    ch_value_pool_t(const ch_value_pool_t&) = delete;
+    ~ch_value_pool_t() {
+        for(auto chunk : chunks_)
+            allocator_traits::deallocate(allocator_, chunk, chunk_size);
+    }
+
+    template<class... Args>
+    uint32_t emplace(Args&&... args) {
+        uint32_t index = used_;
+        if(!free_.empty()) {
+            index = free_.back();
+            free_.pop_back();
+        }
+        else {
+            if((index >> chunk_bits) == chunks_.size())
+                chunks_.push_back(
+                    allocator_traits::allocate(allocator_, chunk_size));
+            ++used_;
+        }
+        allocator_traits::construct(
+            allocator_, &(*this)[index], std::forward<Args>(args)...);
+        return index;
+    }
+
+    void erase(uint32_t index) {
+        allocator_traits::destroy(allocator_, &(*this)[index]);
+        free_.push_back(index);
+    }
+
+    T& operator[](uint32_t index) {
+        return chunks_[index >> chunk_bits][index & chunk_mask];
+    }
+
+    template<class F>
+    void for_each_region(F f) const {
+        for(auto chunk : chunks_)
+            f(static_cast<const void*>(chunk), sizeof(T) * chunk_size);
+    }
+
+    void swap(ch_value_pool_t& other) noexcept {
+        std::swap(allocator_, other.allocator_);
+        chunks_.swap(other.chunks_);
+        free_.swap(other.free_);
+        std::swap(used_, other.used_);
+    }
+
+private:
+    allocator_t allocator_;
+    std::vector<T*> chunks_;
+    std::vector<uint32_t> free_;
+    uint32_t used_ = 0;
+};
+
 /** Insert mode
  * Colliding elements are stored in the same table.
  * References create chains which are subject to so called coalescence.
@@ -119,13 +509,306 @@ struct ch_node_traits : address_node_traits {
  * VICH (variable insert coalesced hashing) */
 enum class coalesced_insertion_mode { LICH, EICH, VICH };
 
+/** Insert status
+ * key_exists - unique insert found the key, iterator points to it
+ * table_full - no free slot left
+ * chain_too_long - chain walk exceeded the given bound
+ * probe_limit - free slot search exceeded the given bound */
+enum class coalesced_insert_status {
+    inserted,
+    key_exists,
+    table_full,
+    chain_too_long,
+    probe_limit
+};
+
+// erase_last closes the erase records of one erase operation
+enum class coalesced_change_op : uint32_t { insert, erase, update, erase_last };
+
+// one logical modification, slot is the index of the touched node
+template<class Key, class T>
+struct coalesced_change_t {
+    uint64_t sequence;
+    coalesced_change_op op;
+    uint32_t slot;
+    Key key;
+    T value;
+};
+
+/** Change log
+ * Ring buffer of modifications of a coalesced_map, drained to disk
+ * between table images. A full buffer drops new records and reports
+ * overflowed(), a new image has to be taken then. Key and T are written
+ * as raw bytes and have to be trivially copyable. */
+template<class Key, class T>
+class coalesced_change_log {
+    static_assert(
+        std::is_trivially_copyable_v<Key> && std::is_trivially_copyable_v<T>,
+        "change log records are persisted as raw bytes");
+
+public:
+    using record_type = coalesced_change_t<Key, T>;
+
+    explicit coalesced_change_log(size_t capacity) : records_(capacity) {
+    }
+
+    bool push(
+        coalesced_change_op op, uint32_t slot, const Key& key,
+        const T& value) {
+        if(size_ == records_.size()) {
+            overflowed_ = true;
+            return false;
+        }
+        records_[(first_ + size_) % records_.size()] =
+            record_type{sequence_++, op, slot, key, value};
+        ++size_;
+        return true;
+    }
+
+    // f(record) for every buffered record in order, buffer is emptied
+    template<class F>
+    size_t drain(F f) {
+        auto count = size_;
+        for(; size_ != 0; --size_) {
+            f(const_cast<const record_type&>(records_[first_]));
+            first_ = (first_ + 1) % records_.size();
+        }
+        return count;
+    }
+
+    size_t drain_to(std::ostream& out) {
+        return drain([&out](const record_type& record) {
+            out.write(reinterpret_cast<const char*>(&record), sizeof(record));
+        });
+    }
+
+    // turns the newest record, an erase, into the last one of its
+    // operation (replay repairs chains once all its erases are marked)
+    void end_erase() {
+        if(size_ == 0)
+            return;
+        auto& record = records_[(first_ + size_ - 1) % records_.size()];
+        if(record.op == coalesced_change_op::erase)
+            record.op = coalesced_change_op::erase_last;
+    }
+
+    // sequence number of the next record
+    uint64_t sequence() const {
+        return sequence_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool overflowed() const {
+        return overflowed_;
+    }
+
+    // after a new image was taken
+    void reset_overflow() {
+        overflowed_ = false;
+    }
+
+private:
+    std::vector<record_type> records_;
+    size_t first_ = 0;
+    size_t size_ = 0;
+    uint64_t sequence_ = 0;
+    bool overflowed_ = false;
+};
+
+/** Image format
+ * Fixed header of a saved table image, followed by capacity + 1 raw nodes.
+ * Format fields (magic to hash_seed, bucket_id) describe the binary
+ * producing the image: a reader built with another node layout, byte
+ * order, hash function or bucket function of its growth policy gets a
+ * mismatch from ch_image_compatible without touching the table and has to
+ * rebuild the table from its source instead. checksum covers the raw
+ * nodes. */
+struct ch_image_header_t {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t endianness;
+    uint32_t insertion_mode;
+    uint32_t node_size;
+    uint32_t node_align;
+    uint32_t capacity;
+    uint32_t address_region;
+    uint32_t freetail;
+    uint32_t head;
+    uint32_t tail;
+    uint32_t size;
+    uint64_t hash_id;
+    uint64_t hash_seed;
+    uint64_t checksum;
+    uint64_t log_sequence;
+    double address_factor;
+    uint32_t bucket_id;
+    uint32_t reserved;
+};
+
+constexpr uint32_t ch_image_magic = 0x4D494843; // "CHIM"
+constexpr uint32_t ch_image_version = 1;
+// reads back as another value on a machine with other byte order
+constexpr uint32_t ch_image_endianness = 0x01020304;
+
+inline uint64_t ch_image_checksum(const void* data, size_t size) {
+    auto bytes = static_cast<const uint8_t*>(data);
+    uint64_t hash = 0x9E3779B97F4A7C15ull ^ size;
+    auto mix = [&hash](uint64_t word) {
+        hash = (hash ^ word) * 0xFF51AFD7ED558CCDull;
+        hash ^= hash >> 32;
+    };
+    size_t pos = 0;
+    for(; pos + 8 <= size; pos += 8) {
+        uint64_t word;
+        std::memcpy(&word, bytes + pos, sizeof(word));
+        mix(word);
+    }
+    if(pos != size) {
+        uint64_t word = 0;
+        std::memcpy(&word, bytes + pos, size - pos);
+        mix(word);
+    }
+    return hash;
+}
+
+template<class Hasher, class = void>
+struct ch_declares_hash_id : std::false_type {};
+
+template<class Hasher>
+struct ch_declares_hash_id<Hasher, std::void_t<decltype(Hasher::hash_id)>>
+    : std::true_type {};
+
+template<class Hasher, class = void>
+struct ch_declares_hash_seed : std::false_type {};
+
+template<class Hasher>
+struct ch_declares_hash_seed<
+    Hasher, std::void_t<decltype(Hasher::hash_seed)>> : std::true_type {};
+
+// Hasher::hash_id when declared, else a fingerprint of the hashes of a few
+// fixed keys (bytes of 0 and 1, valid for any trivially copyable Key)
+template<class Key, class Hasher>
+uint64_t ch_hash_id() {
+    if constexpr(ch_declares_hash_id<Hasher>::value) {
+        return static_cast<uint64_t>(Hasher::hash_id);
+    }
+    else {
+        static_assert(
+            std::is_trivially_copyable_v<Key>,
+            "keys without Hasher::hash_id have to be trivially copyable");
+        uint64_t id = 0;
+        for(uint32_t p = 0; p < 4; ++p) {
+            uint8_t bytes[sizeof(Key)];
+            for(size_t j = 0; j < sizeof(Key); ++j)
+                bytes[j] = static_cast<uint8_t>(((j * 7 + p) >> 1) & 1);
+            Key key;
+            std::memcpy(static_cast<void*>(&key), bytes, sizeof(Key));
+            id = (id ^ uint64_t(Hasher{}(key))) * 0x9E3779B97F4A7C15ull;
+        }
+        return id;
+    }
+}
+
+template<class Hasher>
+uint64_t ch_hash_seed() {
+    if constexpr(ch_declares_hash_seed<Hasher>::value)
+        return static_cast<uint64_t>(Hasher::hash_seed);
+    else
+        return 0;
+}
+
+// header with the format fields a reader of Node tables expects
+template<class Key, class Hasher, class Node, class GrowthPolicy>
+ch_image_header_t ch_image_signature() {
+    ch_image_header_t header{};
+    header.magic = ch_image_magic;
+    header.version = ch_image_version;
+    header.endianness = ch_image_endianness;
+    header.node_size = static_cast<uint32_t>(sizeof(Node));
+    header.node_align = static_cast<uint32_t>(alignof(Node));
+    header.hash_id = ch_hash_id<Key, Hasher>();
+    header.hash_seed = ch_hash_seed<Hasher>();
+    header.bucket_id = GrowthPolicy::bucket_id;
+    return header;
+}
+
+// format fields match signature and table fields are in range, reads
+// nothing but the header
+inline bool ch_image_compatible(
+    const ch_image_header_t& header, const ch_image_header_t& signature) {
+    return header.magic == signature.magic
+        && header.version == signature.version
+        && header.endianness == signature.endianness
+        && header.node_size == signature.node_size
+        && header.node_align == signature.node_align
+        && header.hash_id == signature.hash_id
+        && header.hash_seed == signature.hash_seed
+        && header.bucket_id == signature.bucket_id
+        && header.insertion_mode <= uint32_t(coalesced_insertion_mode::VICH)
+        && header.capacity != 0 && header.capacity != UINT32_MAX
+        && header.address_region != 0
+        && header.address_region <= header.capacity
+        && header.size <= header.capacity
+        && header.freetail <= header.capacity
+        && header.head <= header.capacity && header.tail <= header.capacity;
+}
+
+struct ch_memory_region_t {
+    const void* data;
+    size_t size;
+};
+
+constexpr size_t ch_touch_page_bytes = 4096;
+constexpr size_t ch_touch_block_bytes = 256 * 1024;
+
+/** Prefault
+ * Reads one byte of every page of the regions, blocks of
+ * ch_touch_block_bytes are dealt round-robin to threads workers. Page
+ * faults and TLB misses of a freshly loaded or mapped table are taken
+ * before serving lookups. */
+inline void ch_touch_pages(
+    const ch_memory_region_t* regions, size_t count, unsigned threads) {
+    if(threads == 0)
+        threads = 1;
+    auto run = [=](unsigned t) {
+        size_t block = 0;
+        for(size_t r = 0; r < count; ++r) {
+            auto bytes = static_cast<const volatile uint8_t*>(regions[r].data);
+            auto size = regions[r].size;
+            for(size_t pos = 0; pos < size;
+                pos += ch_touch_block_bytes, ++block) {
+                if(block % threads != t)
+                    continue;
+                auto last = std::min(size, pos + ch_touch_block_bytes);
+                for(auto page = pos; page < last; page += ch_touch_page_bytes)
+                    (void)bytes[page];
+                // region start need not be page aligned
+                (void)bytes[last - 1];
+            }
+        }
+    };
+    std::vector<std::thread> workers;
+    for(unsigned t = 1; t < threads; ++t)
+        workers.emplace_back(run, t);
+    run(0);
+    for(auto& worker : workers)
+        worker.join();
+}
+
 // contiguous memory storage for coalesced hashtable
-template<class Node, class Alloc>
+template<class Node, class Alloc, class HeaderTraits = address_node_traits>
 class coalesced_hashtable {
-    template<class Key, class T, class Hasher, class KeyEq, class Alloc, bool IsMulti>
+    template<
+        class Key, class T, class Hasher, class KeyEq, class A, bool IsMulti,
+        class GrowthPolicy, class Header, class Layout>
     friend class coalesced_map;
 
+protected:
     using node_type = Node;
+    using header_traits = HeaderTraits;
     using storage_ptr = node_type*;
 
     using size_type = uint32_t;
@@ -139,24 +822,37 @@ public:
     explicit coalesced_hashtable(
         size_type size,
         coalesced_insertion_mode mode = coalesced_insertion_mode::LICH,
-        double address_factor = 0.86)
+        double address_factor = 0.86,
+        size_type address_region = 0)
         : capacity_(size)
         , address_factor_(address_factor)
         , insertion_mode_(mode) {
         // TODO: rounding for parameters
         // TODO: asserts
-        address_region_ = static_cast<size_type>(capacity_ * address_factor_);
+        address_region_ = (address_region != 0)
+            ? address_region
+            : static_cast<size_type>(capacity_ * address_factor_);
         cellar_ = static_cast<size_type>(capacity_ - address_region_);
         table_ = allocator_traits::allocate(allocator_, capacity_ + 1);
+        // free slots go into saved images, no stale heap bytes in them
+        std::memset(
+            static_cast<void*>(table_), 0,
+            sizeof(*table_) * (size_t(capacity_) + 1));
         freetail_ = (mode == coalesced_insertion_mode::LICH)
             ? static_cast<uint32_t>(capacity_ - 1)
             : 0;
         head_ = static_cast<uint32_t>(capacity_);
         tail_ = head_;
+        for(size_type i = 0; i <= capacity_; ++i)
+            header_traits::clear(&table_[i]);
     }
     ~coalesced_hashtable() {
         // ensure all objects was destructed
-        allocator_traits::deallocate(allocator_, table_, capacity_);
+        for(size_type i = 0; i <= capacity_; ++i) {
+            if(header_traits::is_allocated(&table_[i]))
+                allocator_traits::destroy(allocator_, &table_[i]);
+        }
+        allocator_traits::deallocate(allocator_, table_, capacity_ + 1);
     }
 
     template<class... Args>
@@ -171,10 +867,66 @@ public:
         allocator_traits::destroy(allocator_, ptr);
     }
 
+    template<class Key, class... Args>
+    void construct_node(storage_ptr ptr, ch_emplace_t<Key, Args...>&& data) {
+        construct_node(
+            ptr, std::piecewise_construct, std::forward_as_tuple(data.key),
+            std::move(data.args));
+    }
+
+    void relocate_node(storage_ptr dst, storage_ptr src) {
+        construct_node(dst, std::move(src->value));
+        release_node(src);
+    }
+
+    // element content for reinsertion into a new table during rehash
+    decltype(auto) extract(storage_ptr ptr) {
+        return std::move(ptr->value);
+    }
+
+    // called on the new table during rehash, before reinsertion
+    void adopt_values(coalesced_hashtable&) {
+    }
+
+    // element access used by map and iterators
+    using reference = node_type&;
+    using pointer = node_type*;
+
+    decltype(auto) value(storage_ptr ptr) {
+        return (ptr->value);
+    }
+
+    reference dereference(storage_ptr ptr) {
+        return *ptr;
+    }
+
+    pointer arrow(storage_ptr ptr) {
+        return ptr;
+    }
+
+    void swap(coalesced_hashtable& other) noexcept {
+        std::swap(allocator_, other.allocator_);
+        std::swap(table_, other.table_);
+        std::swap(freelist_, other.freelist_);
+        std::swap(insertion_mode_, other.insertion_mode_);
+        std::swap(address_factor_, other.address_factor_);
+        std::swap(cellar_, other.cellar_);
+        std::swap(address_region_, other.address_region_);
+        std::swap(capacity_, other.capacity_);
+        std::swap(freetail_, other.freetail_);
+        std::swap(head_, other.head_);
+        std::swap(tail_, other.tail_);
+        std::swap(size_, other.size_);
+    }
+
     storage_ptr get_node(size_t pos) {
         return &table_[pos];
     }
 
+    uint32_t get_index(storage_ptr ptr) const {
+        return static_cast<uint32_t>(ptr - table_);
+    }
+
     bool head_initialized() {
         return (head_ != capacity_);
     }
@@ -189,7 +941,14 @@ public:
         return &table_[tail_];
     }
 
-private:
+    // f(data, size) for every memory block owned by the storage
+    template<class F>
+    void for_each_region(F f) const {
+        f(static_cast<const void*>(table_),
+          sizeof(node_type) * (size_t(capacity_) + 1));
+    }
+
+protected:
     allocator_t allocator_;
     storage_ptr table_{nullptr};
     storage_ptr freelist_{nullptr};
@@ -206,6 +965,283 @@ private:
     uint32_t size_{0};
 };
 
+/** Split storage
+ * Nodes hold links and key only, mapped values sit in a parallel array
+ * indexed by slot. Chain walks stay in the dense key array and only the
+ * final hit touches the value array. The value slot of the sentinel is
+ * never constructed, so T needs no default constructor. */
+template<class Node, class T, class Alloc, class HeaderTraits>
+class coalesced_split_hashtable
+    : public coalesced_hashtable<Node, Alloc, HeaderTraits> {
+    using base_type = coalesced_hashtable<Node, Alloc, HeaderTraits>;
+    using storage_ptr = typename base_type::storage_ptr;
+    using size_type = typename base_type::size_type;
+    using key_type = decltype(std::declval<Node>().key);
+    using value_allocator_t =
+        typename std::allocator_traits<Alloc>::template rebind_alloc<T>;
+    using value_allocator_traits = std::allocator_traits<value_allocator_t>;
+
+public:
+    using reference = ch_split_ref_t<key_type, T>;
+    using pointer = reference;
+
+    explicit coalesced_split_hashtable(
+        size_type size,
+        coalesced_insertion_mode mode = coalesced_insertion_mode::LICH,
+        double address_factor = 0.86,
+        size_type address_region = 0)
+        : base_type(size, mode, address_factor, address_region) {
+        values_ = value_allocator_traits::allocate(
+            value_allocator_, this->capacity_ + 1);
+    }
+    ~coalesced_split_hashtable() {
+        for(size_type i = 0; i < this->capacity_; ++i) {
+            if(HeaderTraits::is_allocated(this->get_node(i)))
+                value_allocator_traits::destroy(value_allocator_, &values_[i]);
+        }
+        value_allocator_traits::deallocate(
+            value_allocator_, values_, this->capacity_ + 1);
+    }
+
+    template<class Pair>
+    void construct_node(storage_ptr ptr, Pair&& data) {
+        base_type::construct_node(ptr, std::forward<Pair>(data).first);
+        value_allocator_traits::construct(
+            value_allocator_, &values_[this->get_index(ptr)],
+            std::forward<Pair>(data).second);
+    }
+
+    template<class... Args>
+    void construct_node(
+        storage_ptr ptr, ch_emplace_t<key_type, Args...>&& data) {
+        base_type::construct_node(ptr, data.key);
+        std::apply(
+            [&](auto&&... args) {
+                value_allocator_traits::construct(
+                    value_allocator_, &values_[this->get_index(ptr)],
+                    std::forward<decltype(args)>(args)...);
+            },
+            std::move(data.args));
+    }
+
+    // sentinel, its value slot stays raw
+    void construct_node(storage_ptr ptr) {
+        base_type::construct_node(ptr);
+    }
+
+    void release_node(storage_ptr ptr) {
+        auto index = this->get_index(ptr);
+        if(index != this->capacity_)
+            value_allocator_traits::destroy(value_allocator_, &values_[index]);
+        base_type::release_node(ptr);
+    }
+
+    void relocate_node(storage_ptr dst, storage_ptr src) {
+        base_type::construct_node(dst, std::move(src->key));
+        value_allocator_traits::construct(
+            value_allocator_, &values_[this->get_index(dst)],
+            std::move(values_[this->get_index(src)]));
+        release_node(src);
+    }
+
+    void swap(coalesced_split_hashtable& other) noexcept {
+        base_type::swap(other);
+        std::swap(value_allocator_, other.value_allocator_);
+        std::swap(values_, other.values_);
+    }
+
+    template<class F>
+    void for_each_region(F f) const {
+        base_type::for_each_region(f);
+        f(static_cast<const void*>(values_),
+          sizeof(T) * (size_t(this->capacity_) + 1));
+    }
+
+    std::pair<const key_type, T> extract(storage_ptr ptr) {
+        return std::pair<const key_type, T>(
+            std::move(ptr->key), std::move(mapped(ptr)));
+    }
+
+    T& mapped(storage_ptr ptr) {
+        return values_[this->get_index(ptr)];
+    }
+
+    std::pair<const key_type&, T&> value(storage_ptr ptr) {
+        return {ptr->key, mapped(ptr)};
+    }
+
+    reference dereference(storage_ptr ptr) {
+        return reference{value(ptr)};
+    }
+
+    pointer arrow(storage_ptr ptr) {
+        return reference{value(ptr)};
+    }
+
+private:
+    value_allocator_t value_allocator_;
+    T* values_{nullptr};
+};
+
+/** Pooled storage
+ * Nodes hold links, key and index of mapped value in a chunked pool.
+ * Rehash and chain repair move only node content, mapped values are
+ * constructed once in place and never moved, so mapped types may be
+ * non-movable and references to them survive table growth. */
+template<class Node, class T, class Alloc, class HeaderTraits>
+class coalesced_pooled_hashtable
+    : public coalesced_hashtable<Node, Alloc, HeaderTraits> {
+    using base_type = coalesced_hashtable<Node, Alloc, HeaderTraits>;
+    using storage_ptr = typename base_type::storage_ptr;
+    using size_type = typename base_type::size_type;
+    using key_type = decltype(std::declval<Node>().key);
+    using pool_type = ch_value_pool_t<T, Alloc>;
+
+public:
+    using reference = ch_split_ref_t<key_type, T>;
+    using pointer = reference;
+
+    explicit coalesced_pooled_hashtable(
+        size_type size,
+        coalesced_insertion_mode mode = coalesced_insertion_mode::LICH,
+        double address_factor = 0.86,
+        size_type address_region = 0)
+        : base_type(size, mode, address_factor, address_region) {
+    }
+    ~coalesced_pooled_hashtable() {
+        for(size_type i = 0; i <= this->capacity_; ++i) {
+            auto ptr = this->get_node(i);
+            if(HeaderTraits::is_allocated(ptr)
+               && ptr->value_index != Node::npos)
+                pool_.erase(ptr->value_index);
+        }
+    }
+
+    template<class Pair>
+    void construct_node(storage_ptr ptr, Pair&& data) {
+        auto index = pool_.emplace(std::forward<Pair>(data).second);
+        base_type::construct_node(ptr, std::forward<Pair>(data).first, index);
+    }
+
+    template<class... Args>
+    void construct_node(
+        storage_ptr ptr, ch_emplace_t<key_type, Args...>&& data) {
+        auto index = std::apply(
+            [this](auto&&... args) {
+                return pool_.emplace(std::forward<decltype(args)>(args)...);
+            },
+            std::move(data.args));
+        base_type::construct_node(ptr, data.key, index);
+    }
+
+    void construct_node(storage_ptr ptr, ch_pool_handle_t<key_type>&& data) {
+        base_type::construct_node(ptr, std::move(data.key), data.index);
+    }
+
+    // sentinel
+    void construct_node(storage_ptr ptr) {
+        base_type::construct_node(ptr);
+    }
+
+    void release_node(storage_ptr ptr) {
+        if(ptr->value_index != Node::npos)
+            pool_.erase(ptr->value_index);
+        base_type::release_node(ptr);
+    }
+
+    void relocate_node(storage_ptr dst, storage_ptr src) {
+        base_type::construct_node(dst, std::move(src->key), src->value_index);
+        base_type::release_node(src);
+    }
+
+    ch_pool_handle_t<key_type> extract(storage_ptr ptr) {
+        auto index = ptr->value_index;
+        ptr->value_index = Node::npos;
+        return ch_pool_handle_t<key_type>{std::move(ptr->key), index};
+    }
+
+    void adopt_values(coalesced_pooled_hashtable& other) {
+        pool_.swap(other.pool_);
+    }
+
+    void swap(coalesced_pooled_hashtable& other) noexcept {
+        base_type::swap(other);
+        pool_.swap(other.pool_);
+    }
+
+    template<class F>
+    void for_each_region(F f) const {
+        base_type::for_each_region(f);
+        pool_.for_each_region(f);
+    }
+
+    T& mapped(storage_ptr ptr) {
+        return pool_[ptr->value_index];
+    }
+
+    std::pair<const key_type&, T&> value(storage_ptr ptr) {
+        return {ptr->key, mapped(ptr)};
+    }
+
+    reference dereference(storage_ptr ptr) {
+        return reference{value(ptr)};
+    }
+
+    pointer arrow(storage_ptr ptr) {
+        return reference{value(ptr)};
+    }
+
+private:
+    pool_type pool_;
+};
+
+// storage of ch_int_node_t, iterators return ch_split_ref_t
+template<class Node, class Alloc, class HeaderTraits>
+class coalesced_int_hashtable
+    : public coalesced_hashtable<Node, Alloc, HeaderTraits> {
+    using base_type = coalesced_hashtable<Node, Alloc, HeaderTraits>;
+    using storage_ptr = typename base_type::storage_ptr;
+    using size_type = typename base_type::size_type;
+    using key_type = decltype(std::declval<Node>().key);
+    using mapped_type = decltype(std::declval<Node>().mapped);
+
+public:
+    using reference = ch_split_ref_t<key_type, mapped_type>;
+    using pointer = reference;
+
+    explicit coalesced_int_hashtable(
+        size_type size,
+        coalesced_insertion_mode mode = coalesced_insertion_mode::LICH,
+        double address_factor = 0.86,
+        size_type address_region = 0)
+        : base_type(size, mode, address_factor, address_region) {
+    }
+
+    void relocate_node(storage_ptr dst, storage_ptr src) {
+        base_type::construct_node(
+            dst, std::piecewise_construct, std::forward_as_tuple(src->key),
+            std::forward_as_tuple(std::move(src->mapped)));
+        base_type::release_node(src);
+    }
+
+    std::pair<const key_type, mapped_type> extract(storage_ptr ptr) {
+        return std::pair<const key_type, mapped_type>(
+            ptr->key, std::move(ptr->mapped));
+    }
+
+    std::pair<const key_type&, mapped_type&> value(storage_ptr ptr) {
+        return {ptr->key, ptr->mapped};
+    }
+
+    reference dereference(storage_ptr ptr) {
+        return reference{value(ptr)};
+    }
+
+    pointer arrow(storage_ptr ptr) {
+        return reference{value(ptr)};
+    }
+};
+
 // TODO: const iterator
 template<class Node, class Traits, class Storage>
 class ch_iterator_t {
@@ -218,9 +1254,11 @@ public:
     using value_type = typename node_traits::value_type;
     using difference_type = ptrdiff_t;
     using node_pointer = node_type*;
-    using node_reference = node_type&;
+    using pointer = typename storage_type::pointer;
+    using reference = typename storage_type::reference;
 
     ch_iterator_t() = default;
+    ch_iterator_t(const ch_iterator_t&) = default;
     ch_iterator_t(storage_type& stor, node_pointer p)
         : storage_(stor), node_(p) {
     }
@@ -237,12 +1275,12 @@ public:
         return (*this);
     }
 
-    node_reference operator*() const {
-        return (*node_);
+    reference operator*() const {
+        return storage_.dereference(node_);
     }
 
-    node_pointer operator->() const {
-        return node_;
+    pointer operator->() const {
+        return storage_.arrow(node_);
     }
 
     bool operator!=(const ch_iterator_t& rhs) const {
@@ -253,6 +1291,10 @@ public:
         return !(*this != rhs);
     }
 
+    node_pointer get_node() const {
+        return node_;
+    }
+
     ch_iterator_t& operator=(const ch_iterator_t& rhs) {
         if(rhs.node_ == node_)
             return (*this);
@@ -265,19 +1307,240 @@ private:
     node_pointer node_{nullptr};
 };
 
+/** Growth policy
+ * Decides the capacity of the next table when coalesced_map grows (0 means
+ * the table never grows and insert reports failure instead), the size of
+ * the address region for a given capacity and how a hash is reduced into
+ * the address region. Slots behind the address region form the cellar. */
+struct growth_policy_base {
+    // only reserves the sentinel slot behind the table, coalesced_map
+    // further caps capacity at HeaderTraits::max_capacity (the slots its
+    // links can address)
+    static constexpr uint32_t max_capacity = UINT32_MAX - 1;
+    // names the bucket function in images, policies overriding bucket
+    // declare their own
+    static constexpr uint32_t bucket_id = 0;
+
+    static inline uint32_t address_region(
+        uint32_t capacity, double address_factor) {
+        auto region = static_cast<uint32_t>(capacity * address_factor);
+        return (region != 0) ? region : 1;
+    }
+    static inline uint32_t bucket(size_t hash, uint32_t address_region) {
+        return static_cast<uint32_t>(hash % address_region);
+    }
+    static inline uint32_t clamp_capacity(uint64_t capacity) {
+        return (capacity > max_capacity) ? 0 : static_cast<uint32_t>(capacity);
+    }
+};
+
+struct doubling_growth_policy : growth_policy_base {
+    static inline uint32_t next_capacity(uint32_t capacity) {
+        return clamp_capacity(uint64_t(capacity) * 2);
+    }
+};
+
+struct one_and_half_growth_policy : growth_policy_base {
+    static inline uint32_t next_capacity(uint32_t capacity) {
+        return clamp_capacity(uint64_t(capacity) + capacity / 2 + 1);
+    }
+};
+
+// address region is the largest prime fitting into capacity * address_factor
+struct prime_growth_policy : growth_policy_base {
+    static inline uint32_t next_capacity(uint32_t capacity) {
+        return clamp_capacity(uint64_t(capacity) * 2);
+    }
+    static inline uint32_t address_region(
+        uint32_t capacity, double address_factor) {
+        auto region =
+            growth_policy_base::address_region(capacity, address_factor);
+        while(region > 2 && !is_prime(region))
+            --region;
+        return region;
+    }
+    static inline bool is_prime(uint32_t n) {
+        if(n % 2 == 0)
+            return n == 2;
+        for(uint32_t i = 3; uint64_t(i) * i <= n; i += 2) {
+            if(n % i == 0)
+                return false;
+        }
+        return true;
+    }
+};
+
+// address region is cut down to a power of two (the rest joins the cellar)
+// so a hash is reduced with a mask instead of a division
+struct power_of_two_growth_policy : growth_policy_base {
+    static inline uint32_t next_capacity(uint32_t capacity) {
+        return clamp_capacity(uint64_t(capacity) * 2);
+    }
+    static inline uint32_t address_region(
+        uint32_t capacity, double address_factor) {
+        auto region =
+            growth_policy_base::address_region(capacity, address_factor);
+        uint32_t pow2 = 1;
+        while(pow2 <= region / 2)
+            pow2 <<= 1;
+        return pow2;
+    }
+    static constexpr uint32_t bucket_id = 1;
+    static inline uint32_t bucket(size_t hash, uint32_t address_region) {
+        return static_cast<uint32_t>(hash & (address_region - 1));
+    }
+};
+
+// never grows, insert into a full table fails
+struct fixed_growth_policy : growth_policy_base {
+    static inline uint32_t next_capacity(uint32_t) {
+        return 0;
+    }
+};
+
+// iterates allocated slots in slot order, used with singly linked headers
+template<class Node, class Traits, class Storage>
+class ch_slot_iterator_t {
+public:
+    using node_type = Node;
+    using node_traits = Traits;
+    using storage_type = Storage;
+
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = typename node_traits::value_type;
+    using difference_type = ptrdiff_t;
+    using node_pointer = node_type*;
+    using pointer = typename storage_type::pointer;
+    using reference = typename storage_type::reference;
+
+    ch_slot_iterator_t() = default;
+    ch_slot_iterator_t(storage_type& stor, node_pointer p)
+        : storage_(&stor), node_(p) {
+    }
+
+    ch_slot_iterator_t& operator++() {
+        auto last = storage_->get_tail();
+        do {
+            ++node_;
+        } while(node_ != last && !node_traits::is_allocated(node_));
+        return (*this);
+    }
+
+    reference operator*() const {
+        return storage_->dereference(node_);
+    }
+
+    pointer operator->() const {
+        return storage_->arrow(node_);
+    }
+
+    bool operator!=(const ch_slot_iterator_t& rhs) const {
+        return (node_ != rhs.node_);
+    }
+
+    bool operator==(const ch_slot_iterator_t& rhs) const {
+        return !(*this != rhs);
+    }
+
+    node_pointer get_node() const {
+        return node_;
+    }
+
+private:
+    storage_type* storage_{nullptr};
+    node_pointer node_{nullptr};
+};
+
+/** Value layout
+ * Binds node type, node traits and storage of coalesced_map.
+ * inline_value_layout - key and mapped value inside the node
+ * split_value_layout - keys and links in the table, mapped values in a
+ *                      parallel array (iterators return ch_split_ref_t)
+ * pooled_value_layout - keys, links and value index in the table, mapped
+ *                       values in a stable chunked pool (iterators return
+ *                       ch_split_ref_t)
+ * integer_key_layout - integral, enum or pointer key and mapped value
+ *                      packed behind the header without a pair (iterators
+ *                      return ch_split_ref_t)
+ *
+ * Invalidation rules (stable_references of layout):
+ * - iterators and pointers to nodes are invalidated by any insert that
+ *   grows the table (rehash_), by shrink_to_fit and by erase (chain repair
+ *   relocates survivors), in every layout
+ * - inline and split layouts move mapped values together with nodes, so
+ *   references to mapped values follow the same rules as iterators
+ * - pooled layout never moves mapped values, references and pointers to a
+ *   mapped value stay valid until that element is erased */
+struct inline_value_layout {
+    static constexpr bool stable_references = false;
+
+    template<class Key, class T, class Alloc, class HeaderTraits>
+    struct bind {
+        using node_traits = ch_node_traits<Key, T, HeaderTraits>;
+        using node_type = typename node_traits::node_type;
+        using storage_type =
+            coalesced_hashtable<node_type, Alloc, HeaderTraits>;
+    };
+};
+
+struct split_value_layout {
+    static constexpr bool stable_references = false;
+
+    template<class Key, class T, class Alloc, class HeaderTraits>
+    struct bind {
+        using node_traits = ch_key_node_traits<Key, T, HeaderTraits>;
+        using node_type = typename node_traits::node_type;
+        using storage_type =
+            coalesced_split_hashtable<node_type, T, Alloc, HeaderTraits>;
+    };
+};
+
+struct pooled_value_layout {
+    static constexpr bool stable_references = true;
+
+    template<class Key, class T, class Alloc, class HeaderTraits>
+    struct bind {
+        using node_traits = ch_pool_node_traits<Key, T, HeaderTraits>;
+        using node_type = typename node_traits::node_type;
+        using storage_type =
+            coalesced_pooled_hashtable<node_type, T, Alloc, HeaderTraits>;
+    };
+};
+
+struct integer_key_layout {
+    static constexpr bool stable_references = false;
+
+    template<class Key, class T, class Alloc, class HeaderTraits>
+    struct bind {
+        static_assert(
+            std::is_integral_v<Key> || std::is_enum_v<Key>
+                || std::is_pointer_v<Key>,
+            "integer_key_layout needs integral, enum or pointer keys");
+        using node_traits = ch_int_node_traits<Key, T, HeaderTraits>;
+        using node_type = typename node_traits::node_type;
+        using storage_type =
+            coalesced_int_hashtable<node_type, Alloc, HeaderTraits>;
+    };
+};
+
 // TODO: move mode to template parameter
 template<
     class Key, class T, class Hasher = std::hash<Key>,
     class KeyEq = std::equal_to<Key>,
-    class Alloc = std::allocator<std::pair<const Key, T>>, bool IsMulti = false>
+    class Alloc = std::allocator<std::pair<const Key, T>>, bool IsMulti = false,
+    class GrowthPolicy = doubling_growth_policy,
+    class HeaderTraits = address_node_traits,
+    class Layout = inline_value_layout>
 class coalesced_map {
     using key_equal = KeyEq;
     using hasher = Hasher;
+    using growth_policy = GrowthPolicy;
     using key_type = Key;
     using mapped_type = T;
     using value_type = std::pair<const Key, T>;
-    using node_type = ch_node_t<Key, T>;
-    using node_traits = ch_node_traits<Key, T>;
+    using layout = typename Layout::template bind<Key, T, Alloc, HeaderTraits>;
+    using node_traits = typename layout::node_traits;
+    using node_type = typename node_traits::node_type;
     using allocator_t =
         typename std::allocator_traits<Alloc>::template rebind_alloc<node_type>;
 
@@ -289,25 +1552,51 @@ class coalesced_map {
     using size_type = uint32_t;
     using difference_type = size_t;
 
-    using storage_type = coalesced_hashtable<node_type, Alloc>;
-    using iterator = ch_iterator_t<node_type, node_traits, storage_type>;
+    using storage_type = typename layout::storage_type;
+    using iterator = std::conditional_t<
+        HeaderTraits::doubly_linked,
+        ch_iterator_t<node_type, node_traits, storage_type>,
+        ch_slot_iterator_t<node_type, node_traits, storage_type>>;
 
     // not multimap
     using pair_ib = std::pair<iterator, bool>;
+    using insert_result = std::pair<iterator, coalesced_insert_status>;
 
     enum {
         min_buckets = 8,
-        multi = IsMulti
+        bulk_lanes = 8,
+        snapshot_page_slots = 1024
     };
 
+    // table bytes covered by one partition of build()
+    static constexpr size_t build_slice_bytes = 256 * 1024;
+
+    // largest table the links of the node header can address
+    static constexpr size_type max_capacity_ = std::min<size_type>(
+        growth_policy::max_capacity, node_traits::max_capacity);
+
+    // 32-bit keys compared bitwise, node fields gathered as 32-bit words
+    static constexpr bool simd_find_ = std::is_integral_v<Key>
+        && sizeof(Key) == 4 && std::is_same_v<KeyEq, std::equal_to<Key>>
+        && std::is_same_v<HeaderTraits, address_node_traits>
+        && sizeof(node_type) % 4 == 0;
+
 public:
+    // node header of saved images
+    using header_traits = HeaderTraits;
+
+    // references to mapped values survive rehash (see Value layout)
+    static constexpr bool stable_references = Layout::stable_references;
+
     coalesced_map() = delete;
     coalesced_map(coalesced_map& other) = delete;
     coalesced_map(
         size_type size,
         coalesced_insertion_mode mode = coalesced_insertion_mode::LICH,
         double address_factor = 0.86)
-        : storage_(size, mode, address_factor) {
+        : storage_(
+            capped_(size), mode, address_factor,
+            growth_policy::address_region(capped_(size), address_factor)) {
         // if(mode == coalesced_insertion_mode::EICH)
         //     link_freelist(storage_);
     }
@@ -339,6 +1628,35 @@ public:
         max_load_factor_ = max_lf;
     }
 
+    // checked on erase, 0 (default) disables downsizing
+    double min_load_factor() const {
+        return min_load_factor_;
+    }
+
+    void min_load_factor(double min_lf) {
+        min_load_factor_ = min_lf;
+    }
+
+    // grows the table so count elements fit without further rehash
+    void reserve(size_type count) {
+        auto new_capacity = fit_capacity_(count);
+        if(new_capacity > bucket_count())
+            rehash_(new_capacity);
+    }
+
+    // rehash into a table of count slots, at least as many as the current
+    // elements need
+    void rehash(size_type count) {
+        rehash_(count);
+    }
+
+    // rehash into the smallest table able to hold current elements
+    void shrink_to_fit() {
+        auto new_capacity = fit_capacity_(size_);
+        if(new_capacity < bucket_count())
+            rehash_(new_capacity);
+    }
+
     bool empty() const {
         return (size_ == 0);
     }
@@ -347,7 +1665,240 @@ public:
         return size_;
     }
 
+    /** Change log and images
+     * Records of inserts, erases and log_update calls go to an attached
+     * change log. save_image writes the raw table (inline layout with
+     * trivially copyable Key and T) stamped with the log sequence,
+     * recovery loads the last image, e.g. from an mmap'ed file, and
+     * applies the records with a later sequence on top of it. Replay is
+     * deterministic, so every record lands in its logged slot. */
+    void attach_change_log(coalesced_change_log<Key, T>* log) {
+        change_log_ = log;
+    }
+
+    // records an in place modification of the mapped value at pos
+    void log_update(iterator pos) {
+        if(change_log_ != nullptr)
+            log_change_(coalesced_change_op::update, pos.get_node());
+    }
+
+    void save_image(std::ostream& out) {
+        check_image_type_();
+        auto header = image_signature();
+        header.insertion_mode = static_cast<uint32_t>(storage_.insertion_mode_);
+        header.capacity = storage_.capacity_;
+        header.address_region = storage_.address_region_;
+        header.freetail = storage_.freetail_;
+        header.head = storage_.head_;
+        header.tail = storage_.tail_;
+        header.size = size_;
+        header.log_sequence = change_log_ ? change_log_->sequence() : 0;
+        header.address_factor = storage_.address_factor_;
+        auto table_bytes = sizeof(node_type) * (size_t(storage_.capacity_) + 1);
+        header.checksum = ch_image_checksum(storage_.table_, table_bytes);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(
+            reinterpret_cast<const char*>(storage_.table_),
+            std::streamsize(table_bytes));
+    }
+
+    // format fields of images this map type writes and reads
+    static ch_image_header_t image_signature() {
+        check_image_type_();
+        return ch_image_signature<Key, Hasher, node_type, GrowthPolicy>();
+    }
+
+    // fast check before load_image, reads the header only: false means
+    // the image comes from an incompatible binary and the table has to be
+    // rebuilt from its source
+    static bool image_compatible(const void* data, size_t size) {
+        ch_image_header_t header;
+        if(size < sizeof(header))
+            return false;
+        std::memcpy(&header, data, sizeof(header));
+        return ch_image_compatible(header, image_signature())
+            && size - sizeof(header)
+            == sizeof(node_type) * (uint64_t(header.capacity) + 1);
+    }
+
+    // replaces content with the image, false when data is no valid image
+    // (incompatible format or checksum mismatch)
+    bool load_image(
+        const void* data, size_t size, uint64_t* log_sequence = nullptr) {
+        check_image_type_();
+        if(!image_compatible(data, size))
+            return false;
+        ch_image_header_t header;
+        std::memcpy(&header, data, sizeof(header));
+        auto table = static_cast<const char*>(data) + sizeof(header);
+        auto table_bytes = size - sizeof(header);
+        if(ch_image_checksum(table, table_bytes) != header.checksum)
+            return false;
+        storage_type image(
+            header.capacity,
+            static_cast<coalesced_insertion_mode>(header.insertion_mode),
+            header.address_factor, header.address_region);
+        std::memcpy(static_cast<void*>(image.table_), table, table_bytes);
+        image.freetail_ = header.freetail;
+        image.head_ = header.head;
+        image.tail_ = header.tail;
+        image.size_ = header.size;
+        storage_.swap(image);
+        size_ = header.size;
+        if(log_sequence != nullptr)
+            *log_sequence = header.log_sequence;
+        return true;
+    }
+
+    /** Warm-up
+     * Touches every page of the table (and of the mapped values of split
+     * and pooled layouts) on threads workers and returns the time taken,
+     * e.g. after load_image and before the process takes traffic. */
+    std::chrono::nanoseconds warm(unsigned threads = 1) const {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<ch_memory_region_t> regions;
+        storage_.for_each_region([&regions](const void* data, size_t size) {
+            if(data != nullptr && size != 0)
+                regions.push_back(ch_memory_region_t{data, size});
+        });
+        ch_touch_pages(regions.data(), regions.size(), threads);
+        return std::chrono::steady_clock::now() - start;
+    }
+
+    // applies one record, false when it did not land in its logged slot
+    bool apply_change(const coalesced_change_t<Key, T>& change) {
+        auto log = std::exchange(change_log_, nullptr);
+        bool applied = true;
+        switch(change.op) {
+        case coalesced_change_op::insert: {
+            auto result = insert(value_type(change.key, change.value));
+            applied = result.second
+                && storage_.get_index(result.first.get_node()) == change.slot;
+            break;
+        }
+        case coalesced_change_op::erase:
+        case coalesced_change_op::erase_last: {
+            // duplicates of the key may live in other slots
+            auto node = storage_.get_node(change.slot);
+            applied = change.slot < storage_.capacity_
+                && node_traits::is_allocated(node)
+                && !node_traits::is_erased(node)
+                && key_equal()(node_traits::key(node), change.key);
+            if(applied) {
+                node_traits::set_erased(node);
+                replay_erased_.push_back(change.slot);
+            }
+            if(change.op == coalesced_change_op::erase_last)
+                repair_replayed_();
+            break;
+        }
+        case coalesced_change_op::update: {
+            auto node = storage_.get_node(change.slot);
+            applied = change.slot < storage_.capacity_
+                && node_traits::is_allocated(node)
+                && key_equal()(node_traits::key(node), change.key);
+            if(applied)
+                storage_.value(node).second = change.value;
+            break;
+        }
+        }
+        change_log_ = log;
+        return applied;
+    }
+
+    // applies drained records with sequence >= from_sequence, returns
+    // number of applied records or -1 on a record off its logged slot
+    int64_t apply_log(std::istream& in, uint64_t from_sequence) {
+        int64_t count = 0;
+        coalesced_change_t<Key, T> change;
+        while(in.read(reinterpret_cast<char*>(&change), sizeof(change))) {
+            if(change.sequence < from_sequence)
+                continue;
+            if(!apply_change(change))
+                return -1;
+            ++count;
+        }
+        return count;
+    }
+
+    /** Copy-on-write snapshot
+     * Consistent view of the elements at the time it was taken. The table
+     * is split into pages of snapshot_page_slots slots, a write that
+     * constructs, destroys or relocates an element first copies the
+     * elements of its page into every live snapshot that has no copy of
+     * that page yet, rehash copies all remaining pages. Untouched pages
+     * are read from the table itself, so the snapshot must not outlive
+     * the map and is read on the writer thread (or under its lock).
+     * While a snapshot is live, lookups copy the page of the element they
+     * return and begin() copies every page, so mapped values can be
+     * changed in place through the returned iterators. */
+    class snapshot {
+    public:
+        // f(key, mapped) for every element, in slot order
+        template<class F>
+        void for_each(F f) const {
+            for(size_t page = 0; page < state_->pages.size(); ++page) {
+                if(state_->copied[page]) {
+                    for(auto& value : state_->pages[page])
+                        f(value.first, value.second);
+                }
+                else {
+                    map_->for_each_in_page_(page, [&f](auto&& value) {
+                        f(value.first, value.second);
+                    });
+                }
+            }
+        }
+
+        size_t size() const {
+            return state_->size;
+        }
+
+    private:
+        friend class coalesced_map;
+        struct state_type {
+            std::vector<std::vector<value_type>> pages;
+            std::vector<uint8_t> copied;
+            size_t size = 0;
+        };
+
+        snapshot(coalesced_map& map, std::shared_ptr<state_type> state)
+            : map_(&map), state_(std::move(state)) {
+        }
+
+        coalesced_map* map_;
+        std::shared_ptr<state_type> state_;
+    };
+
+    snapshot make_snapshot() {
+        static_assert(
+            std::is_copy_constructible_v<mapped_type>,
+            "snapshot copies mapped values");
+        auto state = std::make_shared<typename snapshot::state_type>();
+        auto pages = (uint64_t(storage_.capacity_) + snapshot_page_slots - 1)
+            / snapshot_page_slots;
+        state->pages.resize(pages);
+        state->copied.assign(pages, 0);
+        state->size = size_;
+        snapshots_.erase(
+            std::remove_if(
+                snapshots_.begin(), snapshots_.end(),
+                [](const auto& weak) { return weak.expired(); }),
+            snapshots_.end());
+        snapshots_.push_back(state);
+        return snapshot(*this, std::move(state));
+    }
+
     [[nodiscard]] iterator begin() {
+        copy_all_pages_();
+        if constexpr(!node_traits::doubly_linked) {
+            auto node = storage_.get_node(0);
+            if(node_traits::is_allocated(node))
+                return iterator(storage_, node);
+            return ++iterator(storage_, node);
+        }
+        if(!storage_.head_initialized())
+            return end();
         return iterator(storage_, storage_.get_head());
     }
 
@@ -358,22 +1909,261 @@ public:
     [[nodiscard]] iterator find(const key_type& key) {
         auto slot = get_slot_(key);
         auto node = storage_.get_node(slot);
-        if(!node_traits::is_head(node))
-            return iterator(storage_, storage_.get_head());
+        // home slot may be taken by a node of a coalesced chain
+        if(!node_traits::is_allocated(node))
+            return end();
         if(key_equal()(node_traits::key(node), key))
-            return iterator(storage_, node);
+            return writable_(node);
         while(!node_traits::is_tail(node)) {
             slot = node_traits::next(node);
             node = storage_.get_node(slot);
             if(key_equal()(node_traits::key(node), key))
-                return iterator(storage_, node);
+                return writable_(node);
         }
-        return iterator(storage_, storage_.get_head());
+        return end();
+    }
+
+    /** Bulk find
+     * out[i] receives find(keys[i]). Keys are probed in groups of
+     * bulk_lanes with chain walks interleaved, so cache misses of
+     * independent chains overlap. With AVX2 full groups of 32-bit integral
+     * keys over address headers walk their chains with vector gathers. */
+    void find_bulk(const key_type* keys, size_t count, iterator* out) {
+        uint32_t slots[bulk_lanes];
+        for(size_t i = 0; i < count; i += bulk_lanes) {
+            auto lanes = static_cast<uint32_t>(
+                std::min<size_t>(bulk_lanes, count - i));
+            for(uint32_t j = 0; j < lanes; ++j)
+                slots[j] = get_slot_(keys[i + j]);
+            if(!find_lanes_simd_(keys + i, slots, lanes))
+                find_lanes_(keys + i, slots, lanes);
+            for(uint32_t j = 0; j < lanes; ++j)
+                out[i + j] = writable_(storage_.get_node(slots[j]));
+        }
+    }
+
+    /** Partitioned build
+     * Inserts [first, last) ordered by home slot: rows are radix
+     * partitioned on the high bits of their home slot into slices of
+     * about build_slice_bytes, so each slice of the address region is
+     * filled while it is cache resident. LICH cellar slots are taken from
+     * the top downwards and stay sequential as well. */
+    template<class ForwardIt>
+    void build(ForwardIt first, ForwardIt last) {
+        auto count = static_cast<size_t>(std::distance(first, last));
+        reserve(static_cast<size_type>(size_ + count));
+        uint32_t shift = 0;
+        while((uint64_t(sizeof(node_type)) << shift) < build_slice_bytes)
+            ++shift;
+        auto parts = (uint64_t(storage_.address_region_) >> shift) + 1;
+        std::vector<uint32_t> slots(count);
+        std::vector<size_t> offsets(parts + 1);
+        auto iter = first;
+        for(size_t i = 0; i < count; ++i, ++iter) {
+            slots[i] = get_slot_((*iter).first);
+            ++offsets[(slots[i] >> shift) + 1];
+        }
+        for(size_t p = 1; p <= parts; ++p)
+            offsets[p] += offsets[p - 1];
+        std::vector<ForwardIt> order(count, first);
+        iter = first;
+        for(size_t i = 0; i < count; ++i, ++iter)
+            order[offsets[slots[i] >> shift]++] = iter;
+        for(auto& row : order)
+            insert_or_grow_(value_type(*row));
+    }
+
+    /** Resumable find
+     * find_begin prefetches the home slot, every find_step visits one
+     * chain node and prefetches the next one, returns true when the walk
+     * is over. Lets callers interleave many lookups to hide memory
+     * latency of chain hops (see coalesced_coro.hpp). */
+    struct find_state {
+        key_type key;
+        node_type* node;
+        node_type* found;
+    };
+
+    find_state find_begin(const key_type& key) {
+        auto node = storage_.get_node(get_slot_(key));
+        prefetch_node_(node);
+        return find_state{key, node, nullptr};
+    }
+
+    bool find_step(find_state& state) {
+        auto node = state.node;
+        if(node == nullptr)
+            return true;
+        if(!node_traits::is_allocated(node)) {
+            state.node = nullptr;
+            return true;
+        }
+        if(key_equal()(node_traits::key(node), state.key)) {
+            state.found = node;
+            state.node = nullptr;
+            return true;
+        }
+        if(node_traits::is_tail(node)) {
+            state.node = nullptr;
+            return true;
+        }
+        state.node = storage_.get_node(node_traits::next(node));
+        prefetch_node_(state.node);
+        return false;
+    }
+
+    iterator find_result(const find_state& state) {
+        if(state.found == nullptr)
+            return end();
+        return writable_(state.found);
+    }
+
+    // next element with the key of pos in its chain, end() when none
+    [[nodiscard]] iterator find_next(iterator pos) {
+        auto node = pos.get_node();
+        const auto& key = node_traits::key(node);
+        while(!node_traits::is_tail(node)) {
+            node = storage_.get_node(node_traits::next(node));
+            if(key_equal()(node_traits::key(node), key))
+                return writable_(node);
+        }
+        return end();
     }
 
-    // TODO: check insertion mode (storage_)
     pair_ib insert(value_type&& data) {
-        auto key_ = node_traits::key(data);
+        return insert_or_grow_(std::move(data));
+    }
+
+    // constructs mapped value in place unless key is already present,
+    // lookup and insert share one chain walk (LICH)
+    template<class... Args>
+    pair_ib try_emplace(const key_type& key, Args&&... args) {
+        return insert_or_grow_<true>(ch_emplace_t<key_type, Args...>{
+            key, std::forward_as_tuple(std::forward<Args>(args)...)});
+    }
+
+    // pulls home slot of key into cache ahead of a lookup or insert
+    void prefetch(const key_type& key) {
+        prefetch_node_(storage_.get_node(get_slot_(key)));
+    }
+
+    /** Bounded insert
+     * Never grows the table: at most max_chain chain hops and max_probe
+     * occupied slots skipped by the free slot search, failure reason is
+     * reported back so the caller can shed load. Slots skipped by a failed
+     * search are not visited again by the next one. */
+    insert_result try_insert_no_grow(
+        value_type&& data, size_type max_chain = UINT32_MAX,
+        size_type max_probe = UINT32_MAX) {
+        auto result = insert_(std::move(data), max_chain, max_probe);
+        if(change_log_ != nullptr
+           && result.second == coalesced_insert_status::inserted)
+            log_change_(coalesced_change_op::insert, result.first.get_node());
+        return result;
+    }
+
+    // erase all elements with given key, returns number of erased elements
+    size_t erase(const key_type& key) {
+        auto node = storage_.get_node(get_slot_(key));
+        if(!node_traits::is_allocated(node))
+            return 0;
+        auto tail = node;
+        auto count = mark_chain_(tail, key);
+        if(count == 0)
+            return 0;
+        repair_state_ state;
+        repair_chain_(chain_head_(node, tail), state);
+        release_slots_(state);
+        end_erase_();
+        check_shrink_();
+        return count;
+    }
+
+    /** Bulk erase
+     * Victims are marked first, then every affected chain is repaired
+     * during a single pass over the table and the freed slots are handed
+     * back to the free slot search at once. */
+    template<class KeyRange>
+    size_t erase_batch(const KeyRange& keys) {
+        size_t count = 0;
+        for(const auto& key : keys) {
+            auto node = storage_.get_node(get_slot_(key));
+            if(node_traits::is_allocated(node))
+                count += mark_chain_(node, key);
+        }
+        if(count != 0) {
+            repair_table_([](node_type*) { return false; });
+            end_erase_();
+            check_shrink_();
+        }
+        return count;
+    }
+
+    template<class Pred>
+    size_t erase_if(Pred pred) {
+        auto old_size = size_;
+        repair_table_([this, &pred](node_type* node) {
+            const auto& value = storage_.value(node);
+            return static_cast<bool>(pred(value));
+        });
+        if(old_size != size_) {
+            end_erase_();
+            check_shrink_();
+        }
+        return old_size - size_;
+    }
+
+private:
+    template<bool Unique = false, class Data>
+    pair_ib insert_or_grow_(Data&& data) {
+        if(over_load_(size_ + 1)) {
+            // an update of a present key must not rehash
+            if constexpr(Unique) {
+                auto iter = find(key_of_(data));
+                if(iter != end())
+                    return pair_ib(iter, false);
+            }
+            grow_();
+        }
+        // data is left untouched when insert_ fails
+        auto result = insert_<Unique>(std::forward<Data>(data));
+        if(result.second != coalesced_insert_status::inserted
+           && result.second != coalesced_insert_status::key_exists
+           && grow_())
+            result = insert_<Unique>(std::forward<Data>(data));
+        if(change_log_ != nullptr
+           && result.second == coalesced_insert_status::inserted)
+            log_change_(coalesced_change_op::insert, result.first.get_node());
+        if(result.second == coalesced_insert_status::key_exists)
+            copy_on_write_(result.first.get_node());
+        return pair_ib(
+            result.first, result.second == coalesced_insert_status::inserted);
+    }
+
+    static void prefetch_node_(const node_type* node) {
+#if defined(__GNUC__)
+        __builtin_prefetch(node);
+#else
+        (void)node;
+#endif
+    }
+
+    static const key_type& key_of_(const value_type& data) {
+        return data.first;
+    }
+
+    template<class Data>
+    static const key_type& key_of_(const Data& data) {
+        return data.key;
+    }
+
+    // TODO: check insertion mode (storage_)
+    // Unique: returns key_exists for a key already present in the chain
+    template<bool Unique = false, class Data>
+    insert_result insert_(
+        Data&& data, size_type max_chain = UINT32_MAX,
+        size_type max_probe = UINT32_MAX) {
+        const auto& key_ = key_of_(data);
         auto slot_ = get_slot_(key_);
         auto node = &storage_.table_[slot_];
         auto candidate_node = node;
@@ -381,107 +2171,353 @@ public:
         uint32_t free_index = 0;
         auto probe_counter = lookup_depth;
         if(!node_traits::is_allocated(node)) {
-            construct_(node, data);
+            construct_(node, std::forward<Data>(data));
             node_traits::link_head(node, slot_);
-            if(!storage_.head_initialized())
-                storage_.head_ = slot_;
-            link_to_table_tail(slot_);
-            return pair_ib(iterator(storage_, node), true);
-        }
-        // TODO: multimap
-        // if(key_equal()(node_traits::key(node), key_))
-        //    return pair_ib(iterator(storage_, node), true);
-        while(!node_traits::is_tail(node)) {
-            slot_ = node_traits::next(node);
-            node = storage_.get_node(slot_);
-            // TODO: multimap
-            // if(key_equal()(node_traits::key(node), key_))
-            //    return pair_ib(iterator(storage_, node), true);
+            if constexpr(node_traits::doubly_linked) {
+                if(!storage_.head_initialized())
+                    storage_.head_ = slot_;
+                link_to_table_tail(slot_);
+            }
+            return insert_result(
+                iterator(storage_, node), coalesced_insert_status::inserted);
+        }
+        if constexpr(Unique) {
+            if(key_equal()(node_traits::key(node), key_))
+                return insert_result(
+                    iterator(storage_, node),
+                    coalesced_insert_status::key_exists);
         }
         switch(storage_.insertion_mode_) {
         case coalesced_insertion_mode::VICH:
             [[fallthrough]];
         case coalesced_insertion_mode::EICH:
+            // new node goes right after its home slot, no chain walk
+            // unless key has to be unique
+            if constexpr(Unique) {
+                for(auto chain_node = node;
+                    !node_traits::is_tail(chain_node);) {
+                    chain_node =
+                        storage_.get_node(node_traits::next(chain_node));
+                    if(key_equal()(node_traits::key(chain_node), key_))
+                        return insert_result(
+                            iterator(storage_, chain_node),
+                            coalesced_insert_status::key_exists);
+                }
+            }
             free_index = static_cast<uint32_t>(early_position);
             candidate_node = storage_.get_node(free_index);
             while(node_traits::is_allocated(candidate_node)
-                  && (probe_counter != 0)) {
+                  && (probe_counter != 0)
+                  && (free_index + 1 < storage_.capacity_)) {
                 ++free_index;
                 --probe_counter;
                 candidate_node = storage_.get_node(free_index);
             }
             if(!node_traits::is_allocated(candidate_node)) {
-                construct_(candidate_node, data);
-                auto root_node = storage_.get_node(early_position);
-                auto next_node_pos = node_traits::next(root_node);
-                auto next_node = storage_.get_node(next_node_pos);
-                node_traits::link_(
-                    candidate_node, root_node, free_index, early_position);
-                if(!node_traits::is_allocated(next_node)) {
-                    link_to_table_tail(free_index);
-                }
-                else {
-                    node_traits::set_next(candidate_node, next_node_pos);
-                    node_traits::set_prev(next_node, free_index);
-                }
-                return pair_ib(iterator(storage_, candidate_node), true);
+                construct_(candidate_node, std::forward<Data>(data));
+                link_after_home_(candidate_node, free_index, early_position);
+                return insert_result(
+                    iterator(storage_, candidate_node),
+                    coalesced_insert_status::inserted);
             }
+            // slots below freetail_ are allocated
             free_index = static_cast<uint32_t>(storage_.freetail_);
-            if(free_index >= storage_.capacity_)
-                break;
             while(free_index < storage_.capacity_) {
                 candidate_node = storage_.get_node(free_index);
                 if(node_traits::is_allocated(candidate_node)) {
                     ++free_index;
+                    if(max_probe-- == 0) {
+                        storage_.freetail_ = free_index;
+                        return failed_insert_(
+                            coalesced_insert_status::probe_limit);
+                    }
                     continue;
                 }
-                construct_(candidate_node, data);
-                auto root_node = storage_.get_node(early_position);
-                auto next_node_pos = node_traits::next(root_node);
-                auto next_node = storage_.get_node(next_node_pos);
-                node_traits::link_(
-                    candidate_node, root_node, free_index, early_position);
-                if(!node_traits::is_allocated(next_node)) {
-                    link_to_table_tail(free_index);
-                }
-                else {
-                    node_traits::set_next(candidate_node, next_node_pos);
-                    node_traits::set_prev(next_node, free_index);
-                }
-                return pair_ib(iterator(storage_, candidate_node), true);
+                construct_(candidate_node, std::forward<Data>(data));
+                link_after_home_(candidate_node, free_index, early_position);
+                storage_.freetail_ = free_index + 1;
+                return insert_result(
+                    iterator(storage_, candidate_node),
+                    coalesced_insert_status::inserted);
             }
+            storage_.freetail_ = free_index;
             break;
         case coalesced_insertion_mode::LICH:
+            while(!node_traits::is_tail(node)) {
+                if(max_chain-- == 0)
+                    return failed_insert_(
+                        coalesced_insert_status::chain_too_long);
+                slot_ = node_traits::next(node);
+                node = storage_.get_node(slot_);
+                if constexpr(Unique) {
+                    if(key_equal()(node_traits::key(node), key_))
+                        return insert_result(
+                            iterator(storage_, node),
+                            coalesced_insert_status::key_exists);
+                }
+            }
             // cellar_ + address_region_ late insert
+            // slots above freetail_ are allocated
             free_index = static_cast<uint32_t>(storage_.freetail_);
-            if(free_index > 0) {
-                while(free_index > 0) {
-                    candidate_node = storage_.get_node(free_index);
-                    if(node_traits::is_allocated(candidate_node)) {
-                        --free_index;
-                        continue;
+            while(free_index > 0) {
+                candidate_node = storage_.get_node(free_index);
+                if(node_traits::is_allocated(candidate_node)) {
+                    --free_index;
+                    if(max_probe-- == 0) {
+                        storage_.freetail_ = free_index;
+                        return failed_insert_(
+                            coalesced_insert_status::probe_limit);
                     }
-                    construct_(candidate_node, data);
-                    auto next_node_pos = node_traits::next(node);
-                    auto next_node = storage_.get_node(next_node_pos);
-                    node_traits::link_(candidate_node, node, free_index, slot_);
+                    continue;
+                }
+                construct_(candidate_node, std::forward<Data>(data));
+                auto next_node_pos = node_traits::next(node);
+                auto next_node = storage_.get_node(next_node_pos);
+                node_traits::link_(candidate_node, node, free_index, slot_);
+                if constexpr(node_traits::doubly_linked) {
                     if(!node_traits::is_allocated(next_node))
                         link_to_table_tail(free_index);
                     else {
                         node_traits::set_prev(next_node, free_index);
                         node_traits::set_next(candidate_node, next_node_pos);
                     }
-                    storage_.freetail_ = --free_index;
-                    return pair_ib(iterator(storage_, candidate_node), true);
                 }
+                storage_.freetail_ = --free_index;
+                return insert_result(
+                    iterator(storage_, candidate_node),
+                    coalesced_insert_status::inserted);
             }
+            storage_.freetail_ = free_index;
             break;
         }
-        check_size_();
-        return pair_ib(iterator(storage_, storage_.get_tail()), false);
+        return failed_insert_(coalesced_insert_status::table_full);
+    }
+
+    insert_result failed_insert_(coalesced_insert_status status) {
+        return insert_result(iterator(storage_, storage_.get_tail()), status);
+    }
+
+    // EICH: link node at free_index right behind its home slot
+    void link_after_home_(
+        node_type* candidate_node, uint32_t free_index, uint32_t home) {
+        auto root_node = storage_.get_node(home);
+        auto next_node_pos = node_traits::next(root_node);
+        auto next_node = storage_.get_node(next_node_pos);
+        bool root_is_tail = node_traits::is_tail(root_node);
+        node_traits::link_(candidate_node, root_node, free_index, home);
+        if(!root_is_tail)
+            node_traits::reset_tail(candidate_node);
+        if constexpr(node_traits::doubly_linked) {
+            if(!node_traits::is_allocated(next_node)) {
+                link_to_table_tail(free_index);
+            }
+            else {
+                node_traits::set_next(candidate_node, next_node_pos);
+                node_traits::set_prev(next_node, free_index);
+            }
+        }
+    }
+
+    struct repair_state_ {
+        std::vector<uint32_t> chain;
+        std::vector<uint8_t> filled;
+        uint32_t min_free = UINT32_MAX;
+        uint32_t max_free = 0;
+    };
+
+    // marks matching nodes from node to the chain tail, node ends at tail
+    size_t mark_chain_(node_type*& node, const key_type& key) {
+        size_t count = 0;
+        for(;;) {
+            if(!node_traits::is_erased(node)
+               && key_equal()(node_traits::key(node), key)) {
+                node_traits::set_erased(node);
+                ++count;
+            }
+            if(node_traits::is_tail(node))
+                break;
+            node = storage_.get_node(node_traits::next(node));
+        }
+        return count;
+    }
+
+    uint32_t chain_head_(node_type* node, node_type* tail) {
+        if constexpr(!node_traits::doubly_linked) {
+            return node_traits::next(tail);
+        }
+        else {
+            while(!node_traits::is_head(node))
+                node = storage_.get_node(node_traits::prev(node));
+            return storage_.get_index(node);
+        }
+    }
+
+    // mark nodes matching pred and repair chains chain by chain
+    template<class Pred>
+    void repair_table_(Pred pred) {
+        repair_state_ state;
+        if constexpr(!node_traits::doubly_linked) {
+            // no element list, chains are found by their heads in slot order
+            for(size_type pos = 0; pos < storage_.capacity_; ++pos) {
+                auto node = storage_.get_node(pos);
+                if(node_traits::is_allocated(node) && pred(node))
+                    node_traits::set_erased(node);
+            }
+            for(size_type pos = 0; pos < storage_.capacity_; ++pos) {
+                auto node = storage_.get_node(pos);
+                if(node_traits::is_allocated(node)
+                   && node_traits::is_head(node))
+                    repair_chain_(pos, state);
+            }
+            release_slots_(state);
+            return;
+        }
+        if(!storage_.head_initialized())
+            return;
+        auto pos = storage_.head_;
+        while(pos != storage_.tail_) {
+            auto first = pos;
+            auto node = storage_.get_node(pos);
+            for(;;) {
+                if(pred(node))
+                    node_traits::set_erased(node);
+                if(node_traits::is_tail(node))
+                    break;
+                node = storage_.get_node(node_traits::next(node));
+            }
+            pos = node_traits::next(node);
+            repair_chain_(first, state);
+        }
+        release_slots_(state);
+    }
+
+    /** Chain repair
+     * Erased nodes leave holes in the chain. Surviving node whose home
+     * slot became a hole is moved into it (taking the hole position in the
+     * chain), so its own slot turns into a hole for nodes placed behind
+     * it. Remaining holes are unlinked and freed. */
+    void repair_chain_(uint32_t first, repair_state_& state) {
+        auto& chain = state.chain;
+        auto& filled = state.filled;
+        chain.clear();
+        bool has_erased = false;
+        auto node = storage_.get_node(first);
+        for(auto pos = first;;) {
+            chain.push_back(pos);
+            has_erased |= node_traits::is_erased(node);
+            if(node_traits::is_tail(node))
+                break;
+            pos = node_traits::next(node);
+            node = storage_.get_node(pos);
+        }
+        if(!has_erased)
+            return;
+        bool is_list_head = (first == storage_.head_);
+        uint32_t before = 0;
+        uint32_t after = 0;
+        if constexpr(node_traits::doubly_linked) {
+            before = node_traits::prev(storage_.get_node(first));
+            after = node_traits::next(node);
+        }
+        filled.assign(chain.size(), 1);
+        for(size_t i = 0; i < chain.size(); ++i) {
+            auto pos = chain[i];
+            node = storage_.get_node(pos);
+            if(node_traits::is_erased(node)) {
+                destroy_(node);
+                filled[i] = 0;
+                continue;
+            }
+            auto home = get_slot_(node_traits::key(node));
+            auto home_node = storage_.get_node(home);
+            if(home == pos || node_traits::is_allocated(home_node))
+                continue;
+            size_t hole = 0;
+            while(chain[hole] != home)
+                ++hole;
+            copy_on_write_(home_node);
+            copy_on_write_(node);
+            storage_.relocate_node(home_node, node);
+            node_traits::reset_flags(node);
+            node_traits::set_allocated(home_node);
+            filled[hole] = 1;
+            filled[i] = 0;
+        }
+        uint32_t head = storage_.tail_;
+        uint32_t last = storage_.tail_;
+        for(size_t i = 0; i < chain.size(); ++i) {
+            auto pos = chain[i];
+            if(!filled[i]) {
+                state.min_free = std::min(state.min_free, pos);
+                state.max_free = std::max(state.max_free, pos);
+                continue;
+            }
+            node = storage_.get_node(pos);
+            node_traits::reset_head(node);
+            node_traits::reset_tail(node);
+            if(last == storage_.tail_) {
+                node_traits::set_head(node);
+                head = pos;
+            }
+            else {
+                node_traits::set_next(storage_.get_node(last), pos);
+                if constexpr(node_traits::doubly_linked)
+                    node_traits::set_prev(node, last);
+            }
+            last = pos;
+        }
+        if(last != storage_.tail_)
+            node_traits::set_tail(storage_.get_node(last));
+        if constexpr(node_traits::doubly_linked)
+            link_chain_to_list_(head, last, before, after, is_list_head);
+        else if(last != storage_.tail_)
+            node_traits::set_next(storage_.get_node(last), head);
+    }
+
+    // put repaired chain [head, last] back between before and after
+    void link_chain_to_list_(
+        uint32_t head, uint32_t last, uint32_t before, uint32_t after,
+        bool is_list_head) {
+        if(last != storage_.tail_) {
+            if(is_list_head) {
+                storage_.head_ = head;
+                node_traits::set_prev(storage_.get_node(head), head);
+            }
+            else {
+                node_traits::set_prev(storage_.get_node(head), before);
+                node_traits::set_next(storage_.get_node(before), head);
+            }
+            node_traits::set_next(storage_.get_node(last), after);
+            node_traits::set_prev(storage_.get_node(after), last);
+            return;
+        }
+        // whole chain is gone
+        if(!is_list_head) {
+            node_traits::set_next(storage_.get_node(before), after);
+            node_traits::set_prev(storage_.get_node(after), before);
+        }
+        else if(after != storage_.tail_) {
+            storage_.head_ = after;
+            node_traits::set_prev(storage_.get_node(after), after);
+        }
+        else {
+            // table is empty, sentinel is rebuilt on next insert
+            storage_.head_ = storage_.capacity_;
+            auto tail_node = storage_.get_tail();
+            storage_.release_node(tail_node);
+            node_traits::reset_flags(tail_node);
+        }
+    }
+
+    void release_slots_(const repair_state_& state) {
+        if(state.min_free > state.max_free)
+            return;
+        if(storage_.insertion_mode_ == coalesced_insertion_mode::LICH)
+            storage_.freetail_ = std::max(storage_.freetail_, state.max_free);
+        else
+            storage_.freetail_ = std::min(storage_.freetail_, state.min_free);
     }
 
-private:
     static void link_freelist(storage_type& stor) {
         auto* table = stor.table_;
         auto border = (stor.capacity_ - 1);
@@ -513,49 +2549,442 @@ private:
         node_traits::set_next(actual_tail, pos);
     }
 
+    // replaces home slots with slots of found nodes, misses get tail_
+    void find_lanes_(const key_type* keys, uint32_t* slots, uint32_t lanes) {
+        uint32_t active = 0;
+        for(uint32_t j = 0; j < lanes; ++j) {
+            if(node_traits::is_allocated(storage_.get_node(slots[j])))
+                active |= 1u << j;
+            else
+                slots[j] = storage_.tail_;
+        }
+        while(active != 0) {
+            for(uint32_t j = 0; j < lanes; ++j) {
+                if(0 == (active & (1u << j)))
+                    continue;
+                auto node = storage_.get_node(slots[j]);
+                if(key_equal()(node_traits::key(node), keys[j])) {
+                    active &= ~(1u << j);
+                }
+                else if(node_traits::is_tail(node)) {
+                    slots[j] = storage_.tail_;
+                    active &= ~(1u << j);
+                }
+                else {
+                    slots[j] = node_traits::next(node);
+                }
+            }
+        }
+    }
+
+    // vector variant of find_lanes_, false when not applicable
+    bool find_lanes_simd_(
+        const key_type* keys, uint32_t* slots, uint32_t lanes) {
+#if defined(__AVX2__)
+        if constexpr(simd_find_) {
+            constexpr uint32_t stride = sizeof(node_type) / 4;
+            // gather indices are signed 32-bit words
+            if(lanes != bulk_lanes
+               || uint64_t(storage_.capacity_ + 1) * stride > INT32_MAX)
+                return false;
+            auto first = storage_.get_node(0);
+            auto word = [first](const void* field) {
+                return reinterpret_cast<const int*>(field);
+            };
+            auto prev_base = word(&first->prev);
+            auto next_base = word(&first->next);
+            auto key_base = word(&node_traits::key(first));
+            const __m256i vstride = _mm256_set1_epi32(stride);
+            const __m256i zero = _mm256_setzero_si256();
+            const __m256i allocated = _mm256_set1_epi32(
+                int(address_node_traits::allocated_flag));
+            const __m256i tail =
+                _mm256_set1_epi32(int(address_node_traits::tail_flag));
+            const __m256i probe =
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys));
+            __m256i slot =
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(slots));
+            __m256i result = _mm256_set1_epi32(int(storage_.tail_));
+            __m256i index = _mm256_mullo_epi32(slot, vstride);
+            __m256i prev = _mm256_i32gather_epi32(prev_base, index, 4);
+            __m256i active = _mm256_xor_si256(
+                _mm256_cmpeq_epi32(_mm256_and_si256(prev, allocated), zero),
+                _mm256_cmpeq_epi32(zero, zero));
+            while(!_mm256_testz_si256(active, active)) {
+                index = _mm256_mullo_epi32(slot, vstride);
+                prev = _mm256_mask_i32gather_epi32(
+                    zero, prev_base, index, active, 4);
+                __m256i next = _mm256_mask_i32gather_epi32(
+                    zero, next_base, index, active, 4);
+                __m256i key = _mm256_mask_i32gather_epi32(
+                    zero, key_base, index, active, 4);
+                __m256i hit =
+                    _mm256_and_si256(_mm256_cmpeq_epi32(key, probe), active);
+                result = _mm256_blendv_epi8(result, slot, hit);
+                active = _mm256_andnot_si256(hit, active);
+                __m256i at_tail =
+                    _mm256_cmpeq_epi32(_mm256_and_si256(prev, tail), tail);
+                active = _mm256_andnot_si256(at_tail, active);
+                slot = _mm256_blendv_epi8(slot, next, active);
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(slots), result);
+            return true;
+        }
+#endif
+        (void)keys;
+        (void)slots;
+        (void)lanes;
+        return false;
+    }
+
     uint32_t get_slot_(const key_type& key) {
         return static_cast<uint32_t>(hash_(key));
     }
 
     size_type hash_(const key_type& key) {
-        return hasher{}(key) % storage_.address_region_;
+        return growth_policy::bucket(hasher{}(key), storage_.address_region_);
+    }
+
+    // only tables with raw copyable elements can be logged
+    void log_change_(coalesced_change_op op, node_type* node) {
+        if constexpr(
+            std::is_trivially_copyable_v<Key>
+            && std::is_trivially_copyable_v<T>
+            && std::is_copy_constructible_v<T>) {
+            const auto& value = storage_.value(node);
+            change_log_->push(
+                op, storage_.get_index(node), value.first, value.second);
+        }
+    }
+
+    static void check_image_type_() {
+        static_assert(
+            std::is_same_v<Layout, inline_value_layout>
+                && std::is_trivially_copyable_v<Key>
+                && std::is_trivially_copyable_v<T>,
+            "images are raw copies of inline nodes");
+    }
+
+    template<class F>
+    void for_each_in_page_(size_t page, F f) {
+        auto first = page * snapshot_page_slots;
+        auto last = std::min<size_t>(
+            first + snapshot_page_slots, storage_.capacity_);
+        for(auto pos = first; pos < last; ++pos) {
+            auto node = storage_.get_node(pos);
+            if(node_traits::is_allocated(node))
+                f(storage_.value(node));
+        }
+    }
+
+    // copies page of slot pos into live snapshots before it is modified
+    void copy_on_write_(size_t pos) {
+        if constexpr(std::is_copy_constructible_v<mapped_type>) {
+            if(!snapshots_.empty())
+                copy_page_(pos / snapshot_page_slots);
+        }
+    }
+
+    void copy_page_(size_t page) {
+        for(auto iter = snapshots_.begin(); iter != snapshots_.end();) {
+            auto state = iter->lock();
+            if(!state) {
+                iter = snapshots_.erase(iter);
+                continue;
+            }
+            if(page < state->copied.size() && !state->copied[page]) {
+                auto& copy = state->pages[page];
+                for_each_in_page_(page, [&copy](auto&& value) {
+                    copy.emplace_back(value.first, value.second);
+                });
+                state->copied[page] = 1;
+            }
+            ++iter;
+        }
+    }
+
+    void copy_on_write_(node_type* ptr) {
+        if(!snapshots_.empty())
+            copy_on_write_(storage_.get_index(ptr));
+    }
+
+    void copy_all_pages_() {
+        for(size_t pos = 0; !snapshots_.empty() && pos < storage_.capacity_;
+            pos += snapshot_page_slots)
+            copy_on_write_(pos);
+    }
+
+    // iterator that may change the mapped value of node in place
+    iterator writable_(node_type* node) {
+        if(node != storage_.get_tail())
+            copy_on_write_(node);
+        return iterator(storage_, node);
     }
 
     template<class... Args>
     void construct_(node_type* ptr, Args&&... args) {
+        copy_on_write_(ptr);
         ++size_;
         storage_.construct_node(ptr, std::forward<Args>(args)...);
         node_traits::set_allocated(ptr);
     }
 
-    void check_size_() {
-        if(max_load_factor() < load_factor()) {
-            size_type new_size = bucket_count() * 2;
-            rehash_(new_size);
+    void destroy_(node_type* ptr) {
+        copy_on_write_(ptr);
+        if(change_log_ != nullptr)
+            log_change_(coalesced_change_op::erase, ptr);
+        --size_;
+        storage_.release_node(ptr);
+        node_traits::reset_flags(ptr);
+    }
+
+    bool over_load_(size_type count) const {
+        return double(count) > max_load_factor() * bucket_count();
+    }
+
+    bool grow_() {
+        auto new_capacity = std::min(
+            growth_policy::next_capacity(bucket_count()), max_capacity_);
+        if(new_capacity <= bucket_count())
+            return false;
+        rehash_(new_capacity);
+        return true;
+    }
+
+    void end_erase_() {
+        if constexpr(
+            std::is_trivially_copyable_v<Key>
+            && std::is_trivially_copyable_v<T>
+            && std::is_copy_constructible_v<T>) {
+            if(change_log_ != nullptr)
+                change_log_->end_erase();
         }
     }
 
+    // repairs chains of nodes marked by replayed erase records, as the
+    // logged erase operation did
+    void repair_replayed_() {
+        repair_state_ state;
+        for(auto slot : replay_erased_) {
+            auto node = storage_.get_node(slot);
+            // chain may have been repaired already by an earlier slot
+            if(!node_traits::is_allocated(node)
+               || !node_traits::is_erased(node))
+                continue;
+            auto tail = node;
+            while(!node_traits::is_tail(tail))
+                tail = storage_.get_node(node_traits::next(tail));
+            repair_chain_(chain_head_(node, tail), state);
+        }
+        replay_erased_.clear();
+        release_slots_(state);
+        check_shrink_();
+    }
+
+    void check_shrink_() {
+        if(load_factor() < min_load_factor()) {
+            auto new_capacity = fit_capacity_(size_);
+            if(new_capacity < bucket_count())
+                rehash_(new_capacity);
+        }
+    }
+
+    // capacity keeping load under max_load_factor_, with room for two
+    // more nodes so reinsertion into the new table can't run out of slots
+    size_type fit_capacity_(size_type count) const {
+        auto capacity = static_cast<uint64_t>(count / max_load_factor_);
+        if(capacity < uint64_t(count) + 2)
+            capacity = uint64_t(count) + 2;
+        if(capacity < min_buckets)
+            capacity = min_buckets;
+        return capped_(capacity);
+    }
+
+    // tables beyond max_capacity_ would wrap their links
+    static size_type capped_(uint64_t capacity) {
+        return static_cast<size_type>(
+            std::min<uint64_t>(capacity, max_capacity_));
+    }
+
     void rehash_(size_type new_capacity) {
-        coalesced_insertion_mode mode_ = mode();
-        storage_type new_storage(new_capacity, mode_);
-        auto last = end();
-        for(--last;;) {
-            auto iter = begin();
-            bool done = (last == iter);
-            // insert(*iter, iter)
-            // TODO: call destruct on prev node
-            // TODO: gracefully exchange storage
-            if(done)
-                break;
+        if(new_capacity < fit_capacity_(size_))
+            new_capacity = fit_capacity_(size_);
+        new_capacity = capped_(new_capacity);
+        // old table goes away, snapshots keep their own copy of it
+        copy_all_pages_();
+        storage_type old_storage(
+            new_capacity, mode(), storage_.address_factor_,
+            growth_policy::address_region(
+                new_capacity, storage_.address_factor_));
+        storage_.swap(old_storage);
+        storage_.adopt_values(old_storage);
+        size_ = 0;
+        if constexpr(!node_traits::doubly_linked) {
+            for(size_type pos = 0; pos < old_storage.capacity_; ++pos) {
+                auto node = old_storage.get_node(pos);
+                if(node_traits::is_allocated(node))
+                    insert_(old_storage.extract(node));
+            }
+            return;
+        }
+        if(!old_storage.head_initialized())
+            return;
+        for(auto pos = old_storage.head_; pos != old_storage.tail_;) {
+            auto node = old_storage.get_node(pos);
+            pos = node_traits::next(node);
+            insert_(old_storage.extract(node));
         }
     }
 
 private:
     storage_type storage_;
     double max_load_factor_ = 1;
+    double min_load_factor_ = 0;
     size_type max_size_ = 0;
     size_type size_ = 0;
     size_type lookup_depth = 2;
+    std::vector<std::weak_ptr<typename snapshot::state_type>> snapshots_;
+    coalesced_change_log<Key, T>* change_log_ = nullptr;
+    std::vector<uint32_t> replay_erased_;
+};
+
+/** Multimap
+ * insert never looks for the key, so every coalesced_map keeps duplicate
+ * keys passed to insert (try_emplace is the unique insert) and IsMulti
+ * only names the intent. find returns the first element of a key in its
+ * chain, find_next the following ones, erase removes them all. */
+template<
+    class Key, class T, class Hasher = std::hash<Key>,
+    class KeyEq = std::equal_to<Key>,
+    class Alloc = std::allocator<std::pair<const Key, T>>,
+    class HeaderTraits = address_node_traits,
+    class Layout = inline_value_layout>
+using coalesced_multimap = coalesced_map<
+    Key, T, Hasher, KeyEq, Alloc, true, doubling_growth_policy, HeaderTraits,
+    Layout>;
+
+// map with mapped values never moved by rehash or erase of other elements
+template<
+    class Key, class T, class Hasher = std::hash<Key>,
+    class KeyEq = std::equal_to<Key>,
+    class Alloc = std::allocator<std::pair<const Key, T>>,
+    class HeaderTraits = address_node_traits>
+using coalesced_stable_map = coalesced_map<
+    Key, T, Hasher, KeyEq, Alloc, false, doubling_growth_policy, HeaderTraits,
+    pooled_value_layout>;
+
+/** Integer hasher
+ * Two multiplicative rounds, each followed by folding high bits into low
+ * ones: keys in strides (aligned ids, multiples of a power of two up to
+ * 2^63) still spread over masked address regions, where an identity hash
+ * would leave most buckets empty. */
+template<class Key>
+struct ch_int_hasher {
+    size_t operator()(Key key) const {
+        auto hash = static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ull;
+        hash = (hash ^ (hash >> 32)) * 0xBF58476D1CE4E5B9ull;
+        return static_cast<size_t>(hash ^ (hash >> 29));
+    }
 };
 
+// map of integral keys with packed nodes, 16 bytes for uint32_t ->
+// uint64_t and 24 bytes for uint64_t -> uint64_t with the default header
+template<
+    class Key, class T, class HeaderTraits = singly_address_node_traits,
+    class GrowthPolicy = power_of_two_growth_policy>
+using coalesced_int_map = coalesced_map<
+    Key, T, ch_int_hasher<Key>, std::equal_to<Key>,
+    std::allocator<std::pair<const Key, T>>, false, GrowthPolicy,
+    HeaderTraits, integer_key_layout>;
+
+// number of always zero low bits of a T*
+template<class T>
+constexpr uint32_t ch_pointer_shift() {
+    if constexpr(std::is_void_v<T>) {
+        return 0;
+    }
+    else {
+        uint32_t shift = 0;
+        while((size_t(1) << (shift + 1)) <= alignof(T))
+            ++shift;
+        return shift;
+    }
+}
+
+/** Pointer hasher
+ * Drops the alignment bits (always zero) and mixes the rest like
+ * ch_int_hasher. std::hash<T*> returns the address itself, so with a
+ * masked address region only one bucket out of alignof(T) is ever a home
+ * slot, and consecutive allocations fall into neighbouring buckets. */
+template<class T>
+struct ch_ptr_hasher {
+    size_t operator()(const T* ptr) const {
+        auto bits = reinterpret_cast<uintptr_t>(ptr) >> ch_pointer_shift<T>();
+        return ch_int_hasher<uintptr_t>{}(bits);
+    }
+};
+
+// map of object pointers with packed nodes
+template<class T, class V, class HeaderTraits = singly_address_node_traits>
+using coalesced_ptr_map = coalesced_map<
+    T*, V, ch_ptr_hasher<T>, std::equal_to<T*>,
+    std::allocator<std::pair<T* const, V>>, false, power_of_two_growth_policy,
+    HeaderTraits, integer_key_layout>;
+
+// 32-bit compressed pointer, made and resolved by ch_pointer_codec
+enum class ch_compressed_ptr_t : uint32_t {};
+
+/** Compressed pointers
+ * Pointer to T stored as its offset from a heap base in units of
+ * alignof(T), so 32 bits cover 4G * alignof(T) bytes above base (32 GiB
+ * for 8 byte aligned objects). Offsets have no alignment bits left and
+ * are hashed by ch_int_hasher. The caller picks base below all keyed
+ * objects and checks fits() when the heap may be larger. */
+template<class T>
+class ch_pointer_codec {
+public:
+    static constexpr uint32_t shift = ch_pointer_shift<T>();
+    // bytes addressable above base
+    static constexpr uint64_t range = uint64_t(1) << (32 + shift);
+
+    explicit ch_pointer_codec(const void* base)
+        : base_(reinterpret_cast<uintptr_t>(base)) {
+    }
+
+    bool fits(const T* ptr) const {
+        auto addr = reinterpret_cast<uintptr_t>(ptr);
+        return addr >= base_ && uint64_t(addr - base_) < range
+            && ((addr - base_) & ((uintptr_t(1) << shift) - 1)) == 0;
+    }
+
+    ch_compressed_ptr_t encode(const T* ptr) const {
+        auto offset = (reinterpret_cast<uintptr_t>(ptr) - base_) >> shift;
+        return static_cast<ch_compressed_ptr_t>(offset);
+    }
+
+    T* decode(ch_compressed_ptr_t value) const {
+        auto offset = uintptr_t(static_cast<uint32_t>(value)) << shift;
+        return reinterpret_cast<T*>(base_ + offset);
+    }
+
+private:
+    uintptr_t base_;
+};
+
+// map keyed by compressed pointers, 16 byte nodes for 8 byte values
+template<class V, class HeaderTraits = singly_address_node_traits>
+using coalesced_compressed_ptr_map =
+    coalesced_int_map<ch_compressed_ptr_t, V, HeaderTraits>;
+
+template<
+    class Key, class T, class Hasher, class KeyEq, class Alloc, bool IsMulti,
+    class GrowthPolicy, class HeaderTraits, class Layout, class Pred>
+size_t erase_if(
+    coalesced_map<
+        Key, T, Hasher, KeyEq, Alloc, IsMulti, GrowthPolicy, HeaderTraits,
+        Layout>& map,
+    Pred pred) {
+    return map.erase_if(pred);
+}
+
 } // namespace coalesced_hash
@@ -0,0 +1,180 @@
+#pragma once
+// Build/probe hash join on top of coalesced_map
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "coalesced_hashtable.hpp"
+
+namespace coalesced_hash {
+
+// probe_index is the position of the probe key, build points into the table
+template<class Key, class T>
+struct coalesced_join_match {
+    size_t probe_index;
+    const std::pair<const Key, T>* build;
+};
+
+/** Hash join
+ * Build rows are scattered by hash into one slice per thread in a single
+ * pass, every multimap is reserved for its exact row count and filled
+ * from its slice by its own thread. Probe
+ * looks keys up in batches of bulk_lanes through find_bulk of their maps
+ * and writes matches into a caller buffer, a probe stopped by a full
+ * buffer resumes on the next call, so probing never allocates. */
+template<
+    class Key, class T, class Hasher = std::hash<Key>,
+    class KeyEq = std::equal_to<Key>>
+class coalesced_join {
+public:
+    using map_type = coalesced_multimap<Key, T, Hasher, KeyEq>;
+    using match_type = coalesced_join_match<Key, T>;
+
+    coalesced_join() = default;
+    coalesced_join(const coalesced_join&) = delete;
+
+    // RandomIt dereferences to std::pair<Key, T>
+    template<class RandomIt>
+    void build(RandomIt first, RandomIt last, unsigned threads = 1) {
+        if(threads == 0)
+            threads = 1;
+        auto count = static_cast<size_t>(std::distance(first, last));
+        // one scatter pass puts the rows of each part into its own slice
+        std::vector<uint32_t> parts(count);
+        std::vector<size_t> offsets(threads + 1);
+        for(size_t i = 0; i < count; ++i) {
+            parts[i] = partition_(first[i].first, threads);
+            ++offsets[parts[i] + 1];
+        }
+        for(unsigned p = 1; p <= threads; ++p)
+            offsets[p] += offsets[p - 1];
+        std::vector<size_t> rows(count);
+        std::vector<size_t> fill_at(offsets.begin(), offsets.end() - 1);
+        for(size_t i = 0; i < count; ++i)
+            rows[fill_at[parts[i]]++] = i;
+        maps_.clear();
+        for(unsigned p = 0; p < threads; ++p) {
+            maps_.emplace_back(new map_type(min_buckets_));
+            maps_.back()->reserve(
+                static_cast<uint32_t>(offsets[p + 1] - offsets[p]));
+        }
+        // iterators keep their map, every map gets its own result lanes
+        results_.clear();
+        batch_keys_.clear();
+        for(auto& map : maps_) {
+            results_.emplace_back(bulk_lanes_, map->end());
+            batch_keys_.emplace_back();
+            batch_keys_.back().reserve(bulk_lanes_);
+        }
+        auto fill = [&](unsigned p) {
+            auto& map = *maps_[p];
+            for(size_t i = offsets[p]; i < offsets[p + 1]; ++i)
+                map.insert({first[rows[i]].first, first[rows[i]].second});
+        };
+        std::vector<std::thread> workers;
+        for(unsigned p = 1; p < threads; ++p)
+            workers.emplace_back(fill, p);
+        fill(0);
+        for(auto& worker : workers)
+            worker.join();
+    }
+
+    // starts a new probe pass over keys, keys must outlive the pass
+    void probe(const Key* keys, size_t count) {
+        keys_ = keys;
+        count_ = count;
+        position_ = 0;
+        batch_begin_ = 0;
+        batch_end_ = 0;
+    }
+
+    // writes up to capacity matches, 0 when the probe pass is exhausted
+    size_t next(match_type* out, size_t capacity) {
+        size_t written = 0;
+        while(written < capacity) {
+            if(position_ == batch_end_) {
+                if(position_ == count_)
+                    break;
+                find_batch_();
+            }
+            auto lane = position_ - batch_begin_;
+            auto& map = *maps_[lane_map_[lane]];
+            auto& iter = results_[lane_map_[lane]][lane_slot_[lane]];
+            if(iter == map.end()) {
+                ++position_;
+                continue;
+            }
+            out[written++] = match_type{position_, &iter->value};
+            iter = map.find_next(iter);
+        }
+        return written;
+    }
+
+    size_t size() const {
+        size_t result = 0;
+        for(auto& map : maps_)
+            result += map->size();
+        return result;
+    }
+
+private:
+    using iterator = decltype(std::declval<map_type&>().end());
+    static constexpr uint32_t min_buckets_ = 8;
+    // lanes find_bulk of the maps interleaves
+    static constexpr size_t bulk_lanes_ = 8;
+
+    // routes the next bulk_lanes probe keys to their maps and finds them
+    void find_batch_() {
+        batch_begin_ = position_;
+        batch_end_ = std::min(count_, position_ + bulk_lanes_);
+        if(maps_.size() == 1) {
+            for(size_t i = batch_begin_; i < batch_end_; ++i) {
+                lane_map_[i - batch_begin_] = 0;
+                lane_slot_[i - batch_begin_] = uint32_t(i - batch_begin_);
+            }
+            maps_[0]->find_bulk(
+                keys_ + batch_begin_, batch_end_ - batch_begin_,
+                results_[0].data());
+            return;
+        }
+        for(auto& keys : batch_keys_)
+            keys.clear();
+        for(size_t i = batch_begin_; i < batch_end_; ++i) {
+            auto p = partition_(keys_[i], unsigned(maps_.size()));
+            lane_map_[i - batch_begin_] = p;
+            lane_slot_[i - batch_begin_] = uint32_t(batch_keys_[p].size());
+            batch_keys_[p].push_back(keys_[i]);
+        }
+        for(size_t p = 0; p < maps_.size(); ++p) {
+            if(!batch_keys_[p].empty())
+                maps_[p]->find_bulk(
+                    batch_keys_[p].data(), batch_keys_[p].size(),
+                    results_[p].data());
+        }
+    }
+
+    // top bits of a mixed hash, bucket of a map uses the low ones
+    static uint32_t partition_(const Key& key, unsigned parts) {
+        uint64_t mixed = uint64_t(Hasher{}(key)) * 0x9E3779B97F4A7C15ull;
+        return static_cast<uint32_t>(((mixed >> 32) * parts) >> 32);
+    }
+
+    std::vector<std::unique_ptr<map_type>> maps_;
+    const Key* keys_ = nullptr;
+    size_t count_ = 0;
+    size_t position_ = 0;
+    // probe keys [batch_begin_, batch_end_) were found, lane i sits in
+    // results_[lane_map_[i]][lane_slot_[i]]
+    size_t batch_begin_ = 0;
+    size_t batch_end_ = 0;
+    uint32_t lane_map_[bulk_lanes_] = {};
+    uint32_t lane_slot_[bulk_lanes_] = {};
+    std::vector<std::vector<iterator>> results_;
+    std::vector<std::vector<Key>> batch_keys_;
+};
+
+} // namespace coalesced_hash
@@ -0,0 +1,321 @@
+#pragma once
+// Segmented coalesced map, every segment has its own address region and
+// cellar
+
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "coalesced_hashtable.hpp"
+
+namespace coalesced_hash {
+
+// walks all elements of all segments, segment by segment
+template<class Map, class SegmentIterator>
+class ch_segmented_iterator_t {
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = typename SegmentIterator::value_type;
+    using difference_type = ptrdiff_t;
+    using pointer = typename SegmentIterator::pointer;
+    using reference = typename SegmentIterator::reference;
+
+    ch_segmented_iterator_t(
+        Map& map, size_t segment, const SegmentIterator& iter)
+        : map_(&map), segment_(segment), iter_(iter) {
+        skip_empty_();
+    }
+    ch_segmented_iterator_t(const ch_segmented_iterator_t&) = default;
+
+    ch_segmented_iterator_t& operator=(const ch_segmented_iterator_t& rhs) {
+        map_ = rhs.map_;
+        segment_ = rhs.segment_;
+        iter_.emplace(*rhs.iter_);
+        return (*this);
+    }
+
+    ch_segmented_iterator_t& operator++() {
+        ++*iter_;
+        skip_empty_();
+        return (*this);
+    }
+
+    reference operator*() const {
+        return **iter_;
+    }
+
+    pointer operator->() const {
+        return iter_->operator->();
+    }
+
+    bool operator!=(const ch_segmented_iterator_t& rhs) const {
+        return (segment_ != rhs.segment_ || *iter_ != *rhs.iter_);
+    }
+
+    bool operator==(const ch_segmented_iterator_t& rhs) const {
+        return !(*this != rhs);
+    }
+
+    size_t segment() const {
+        return segment_;
+    }
+
+    const SegmentIterator& segment_iterator() const {
+        return *iter_;
+    }
+
+private:
+    // segment iterators keep a reference to their storage, so moving to
+    // the next segment constructs a new one
+    void skip_empty_() {
+        while(*iter_ == map_->segment(segment_).end()
+              && segment_ + 1 < map_->segment_count()) {
+            ++segment_;
+            iter_.emplace(map_->segment(segment_).begin());
+        }
+    }
+
+    Map* map_;
+    size_t segment_;
+    std::optional<SegmentIterator> iter_;
+};
+
+/** Segmented map
+ * Keys are routed by the top bits of a mixed hash to one of
+ * 2^segment_bits independent coalesced_map segments. Collisions stay in
+ * the cellar of their own segment, close to the home slot, and a segment
+ * grows or rehashes alone, so peak memory of growth is one segment.
+ * Segments share no state: callers may guard each segment_index with its
+ * own lock.
+ *
+ * Extendible growth: a segment that reached max_segment_capacity splits
+ * instead of doubling. A directory of 2^global_depth entries maps hash
+ * prefixes to segments, a segment with local depth d owns all entries
+ * sharing its d bit prefix. Split moves the elements with the next prefix
+ * bit set into a new segment of the same capacity, doubling only the
+ * directory when d reaches global_depth. */
+template<
+    class Key, class T, class Hasher = std::hash<Key>,
+    class KeyEq = std::equal_to<Key>,
+    class Alloc = std::allocator<std::pair<const Key, T>>, bool IsMulti = false,
+    class HeaderTraits = address_node_traits,
+    class Layout = inline_value_layout>
+class coalesced_segmented_map {
+public:
+    using key_type = Key;
+    using mapped_type = T;
+    using value_type = std::pair<const Key, T>;
+    using segment_type = coalesced_map<
+        Key, T, Hasher, KeyEq, Alloc, IsMulti, doubling_growth_policy,
+        HeaderTraits, Layout>;
+    using segment_iterator = decltype(std::declval<segment_type&>().end());
+    using iterator =
+        ch_segmented_iterator_t<coalesced_segmented_map, segment_iterator>;
+    using pair_ib = std::pair<iterator, bool>;
+
+    coalesced_segmented_map(
+        uint32_t segment_bits, uint32_t segment_capacity,
+        coalesced_insertion_mode mode = coalesced_insertion_mode::LICH,
+        double address_factor = 0.86)
+        : global_depth_(segment_bits)
+        , mode_(mode)
+        , address_factor_(address_factor) {
+        for(size_t i = 0; i < (size_t(1) << segment_bits); ++i) {
+            segments_.emplace_back(
+                new segment_type(segment_capacity, mode, address_factor));
+            depths_.push_back(segment_bits);
+            directory_.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    coalesced_segmented_map(coalesced_segmented_map& other) = delete;
+
+    size_t segment_count() const {
+        return segments_.size();
+    }
+
+    segment_type& segment(size_t index) {
+        return *segments_[index];
+    }
+
+    // segment holding key, bucket of a segment uses the low hash bits
+    size_t segment_index(const key_type& key) const {
+        return directory_[prefix_(mix_(key), global_depth_)];
+    }
+
+    uint32_t global_depth() const {
+        return global_depth_;
+    }
+
+    uint32_t max_segment_capacity() const {
+        return max_segment_capacity_;
+    }
+
+    // segments at this capacity split instead of growing
+    void max_segment_capacity(uint32_t capacity) {
+        max_segment_capacity_ = capacity;
+    }
+
+    size_t size() const {
+        size_t result = 0;
+        for(auto& segment : segments_)
+            result += segment->size();
+        return result;
+    }
+
+    bool empty() const {
+        return (size() == 0);
+    }
+
+    [[nodiscard]] iterator begin() {
+        return iterator(*this, 0, segments_.front()->begin());
+    }
+
+    [[nodiscard]] iterator end() {
+        auto last = segments_.size() - 1;
+        return iterator(*this, last, segments_.back()->end());
+    }
+
+    [[nodiscard]] iterator find(const key_type& key) {
+        auto index = segment_index(key);
+        return wrap_(index, segments_[index]->find(key));
+    }
+
+    pair_ib insert(value_type&& data) {
+        for(;;) {
+            auto index = segment_index(data.first);
+            auto& segment = *segments_[index];
+            if(grows_past_limit_(index)) {
+                segment.rehash(max_segment_capacity_);
+                continue;
+            }
+            if(!splits_(index)) {
+                auto result = segment.insert(std::move(data));
+                return pair_ib(wrap_(index, result.first), result.second);
+            }
+            // data is left untouched when the bounded insert fails
+            if(double(segment.size() + 1)
+               <= segment.max_load_factor() * segment.bucket_count()) {
+                auto result = segment.try_insert_no_grow(std::move(data));
+                if(result.second == coalesced_insert_status::inserted)
+                    return pair_ib(wrap_(index, result.first), true);
+            }
+            split_(index);
+        }
+    }
+
+    template<class... Args>
+    pair_ib try_emplace(const key_type& key, Args&&... args) {
+        auto index = segment_index(key);
+        if(splits_(index) || grows_past_limit_(index)) {
+            auto iter = find(key);
+            if(iter != end())
+                return pair_ib(iter, false);
+            return insert(value_type(
+                std::piecewise_construct, std::forward_as_tuple(key),
+                std::forward_as_tuple(std::forward<Args>(args)...)));
+        }
+        auto result =
+            segments_[index]->try_emplace(key, std::forward<Args>(args)...);
+        return pair_ib(wrap_(index, result.first), result.second);
+    }
+
+    size_t erase(const key_type& key) {
+        return segments_[segment_index(key)]->erase(key);
+    }
+
+    template<class Pred>
+    size_t erase_if(Pred pred) {
+        size_t count = 0;
+        for(auto& segment : segments_)
+            count += segment->erase_if(pred);
+        return count;
+    }
+
+    void max_load_factor(double max_lf) {
+        max_load_factor_ = max_lf;
+        for(auto& segment : segments_)
+            segment->max_load_factor(max_lf);
+    }
+
+private:
+    // end of a segment means end of the whole map
+    iterator wrap_(size_t index, const segment_iterator& iter) {
+        if(iter == segments_[index]->end())
+            return end();
+        return iterator(*this, index, iter);
+    }
+
+    static uint64_t mix_(const key_type& key) {
+        return uint64_t(Hasher{}(key)) * 0x9E3779B97F4A7C15ull;
+    }
+
+    static size_t prefix_(uint64_t mixed, uint32_t depth) {
+        return (depth == 0) ? 0 : static_cast<size_t>(mixed >> (64 - depth));
+    }
+
+    // segment reached its size limit, a full one splits instead of growing
+    bool splits_(size_t index) const {
+        return segments_[index]->bucket_count() >= max_segment_capacity_
+            && depths_[index] < max_depth;
+    }
+
+    // next doubling would take a segment past max_segment_capacity_, it
+    // grows to the limit instead and splits from there
+    bool grows_past_limit_(size_t index) const {
+        auto& segment = *segments_[index];
+        auto capacity = segment.bucket_count();
+        auto next = doubling_growth_policy::next_capacity(capacity);
+        return capacity < max_segment_capacity_
+            && (next == 0 || next > max_segment_capacity_)
+            && double(segment.size() + 1)
+            > segment.max_load_factor() * capacity;
+    }
+
+    void split_(size_t index) {
+        if(depths_[index] == global_depth_) {
+            std::vector<uint32_t> directory(directory_.size() * 2);
+            for(size_t i = 0; i < directory.size(); ++i)
+                directory[i] = directory_[i >> 1];
+            directory_.swap(directory);
+            ++global_depth_;
+        }
+        auto depth = ++depths_[index];
+        auto buddy = static_cast<uint32_t>(segments_.size());
+        auto& segment = *segments_[index];
+        segments_.emplace_back(new segment_type(
+            segment.bucket_count(), mode_, address_factor_));
+        depths_.push_back(depth);
+        auto& target = *segments_.back();
+        target.max_load_factor(max_load_factor_);
+        // entries of index with the new prefix bit set move to buddy
+        for(size_t i = 0; i < directory_.size(); ++i) {
+            if(directory_[i] == index && ((i >> (global_depth_ - depth)) & 1))
+                directory_[i] = buddy;
+        }
+        auto moves = [depth](const key_type& key) {
+            return 0 != (prefix_(mix_(key), depth) & 1);
+        };
+        for(auto iter = segment.begin(); iter != segment.end(); ++iter) {
+            auto&& value = iter->value;
+            if(moves(value.first))
+                target.insert({value.first, std::move(value.second)});
+        }
+        segment.erase_if(
+            [&moves](const auto& value) { return moves(value.first); });
+    }
+
+    static constexpr uint32_t max_depth = 24;
+
+    uint32_t global_depth_;
+    std::vector<uint32_t> directory_;
+    std::vector<uint32_t> depths_;
+    std::vector<std::unique_ptr<segment_type>> segments_;
+    coalesced_insertion_mode mode_;
+    double address_factor_;
+    double max_load_factor_ = 1;
+    uint32_t max_segment_capacity_ = UINT32_MAX;
+};
+
+} // namespace coalesced_hash
@@ -1,19 +1,37 @@
 // clang-format off
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
 #include <memory>
+#include <sstream>
 #include <unordered_map>
 #include <string>
 #include <iostream>
 #include <typeinfo>
+#include <vector>
 
+#include "coalesced_aggregator.hpp"
+#include "coalesced_async.hpp"
+#include "coalesced_compress.hpp"
+#include "coalesced_coro.hpp"
 #include "coalesced_hashtable.hpp"
+#include "coalesced_join.hpp"
+#include "coalesced_segmented.hpp"
+#include "coalesced_view.hpp"
 
 #include "gtest/gtest.h"
 // clang-format on
 
+template<class Key, class T, class GrowthPolicy>
+using policy_map_t = coalesced_hash::coalesced_map<
+    Key, T, std::hash<Key>, std::equal_to<Key>,
+    std::allocator<std::pair<const Key, T>>, false, GrowthPolicy>;
+
 TEST(coalesced_hashtable_test, simple_insert) {
     auto test_size_ = 10;
-    coalesced_hash::coalesced_map<int, int> cmap_(test_size_);
+    policy_map_t<int, int, coalesced_hash::fixed_growth_policy> cmap_(
+        test_size_);
     auto iter = cmap_.insert(std::make_pair<int, int>(2, 2));
     EXPECT_EQ(iter.second, true);
     EXPECT_EQ(cmap_.insert({2, 8}).second, true);
@@ -66,6 +84,1055 @@ TEST(coalesced_hashtable_test, early_insertion) {
     EXPECT_EQ(coalesced_hash::address_node_traits::is_tail(&*iter), true);
 }
 
+TEST(coalesced_hashtable_test, erase_batch) {
+    coalesced_hash::coalesced_map<int, int> cmap_(100);
+    for(int i = 0; i < 80; ++i)
+        EXPECT_EQ(cmap_.insert({i * 7, i}).second, true);
+    std::vector<int> victims;
+    for(int i = 0; i < 80; i += 3)
+        victims.push_back(i * 7);
+    EXPECT_EQ(cmap_.erase_batch(victims), victims.size());
+    EXPECT_EQ(cmap_.size(), 80 - victims.size());
+    for(int i = 0; i < 80; ++i) {
+        auto iter = cmap_.find(i * 7);
+        if(i % 3 == 0) {
+            EXPECT_EQ(iter == cmap_.end(), true);
+            continue;
+        }
+        ASSERT_EQ(iter == cmap_.end(), false);
+        EXPECT_EQ(iter->value.second, i);
+    }
+    EXPECT_EQ(cmap_.erase(7), 1);
+    EXPECT_EQ(cmap_.erase(7), 0);
+    EXPECT_EQ(std::distance(cmap_.begin(), cmap_.end()), cmap_.size());
+    for(auto key : victims)
+        EXPECT_EQ(cmap_.insert({key, -1}).second, true);
+    EXPECT_EQ(cmap_.find(21)->value.second, -1);
+    EXPECT_EQ(cmap_.find(14)->value.second, 2);
+}
+
+TEST(coalesced_hashtable_test, erase_if) {
+    coalesced_hash::coalesced_map<int, int> cmap_(
+        64, coalesced_hash::coalesced_insertion_mode::EICH);
+    for(int i = 0; i < 50; ++i)
+        cmap_.insert({i * 5, i});
+    auto count = coalesced_hash::erase_if(
+        cmap_, [](const auto& value) { return value.second % 2 == 0; });
+    EXPECT_EQ(count, 25);
+    EXPECT_EQ(cmap_.size(), 25);
+    for(int i = 0; i < 50; ++i)
+        EXPECT_EQ(cmap_.find(i * 5) == cmap_.end(), i % 2 == 0);
+    coalesced_hash::erase_if(cmap_, [](const auto&) { return true; });
+    EXPECT_EQ(cmap_.empty(), true);
+    EXPECT_EQ(cmap_.begin() == cmap_.end(), true);
+    EXPECT_EQ(cmap_.insert({5, 5}).second, true);
+    EXPECT_EQ(cmap_.find(5)->value.second, 5);
+}
+
+TEST(coalesced_hashtable_test, shrink_to_fit) {
+    coalesced_hash::coalesced_map<int, std::string> cmap_(1000);
+    for(int i = 0; i < 200; ++i)
+        cmap_.insert({i, std::to_string(i)});
+    cmap_.shrink_to_fit();
+    EXPECT_EQ(cmap_.bucket_count() < 1000, true);
+    EXPECT_EQ(cmap_.size(), 200);
+    for(int i = 0; i < 200; ++i)
+        EXPECT_EQ(cmap_.find(i)->value.second, std::to_string(i));
+}
+
+TEST(coalesced_hashtable_test, min_load_factor) {
+    coalesced_hash::coalesced_map<int, int> cmap_(1000);
+    cmap_.min_load_factor(0.1);
+    for(int i = 0; i < 500; ++i)
+        cmap_.insert({i, i});
+    EXPECT_EQ(cmap_.bucket_count(), 1000);
+    coalesced_hash::erase_if(
+        cmap_, [](const auto& value) { return value.first >= 50; });
+    EXPECT_EQ(cmap_.bucket_count() < 1000, true);
+    EXPECT_EQ(cmap_.size(), 50);
+    for(int i = 0; i < 500; ++i)
+        EXPECT_EQ(cmap_.find(i) == cmap_.end(), i >= 50);
+}
+
+template<class GrowthPolicy>
+void check_growth_policy() {
+    policy_map_t<int, int, GrowthPolicy> cmap_(10);
+    for(int i = 0; i < 1000; ++i)
+        ASSERT_EQ(cmap_.insert({i * 3, i}).second, true);
+    EXPECT_EQ(cmap_.size(), 1000);
+    EXPECT_EQ(cmap_.bucket_count() >= 1000, true);
+    for(int i = 0; i < 1000; ++i)
+        ASSERT_EQ(cmap_.find(i * 3)->value.second, i);
+}
+
+TEST(coalesced_hashtable_test, growth_policy) {
+    check_growth_policy<coalesced_hash::doubling_growth_policy>();
+    check_growth_policy<coalesced_hash::one_and_half_growth_policy>();
+    check_growth_policy<coalesced_hash::prime_growth_policy>();
+    check_growth_policy<coalesced_hash::power_of_two_growth_policy>();
+    EXPECT_EQ(
+        coalesced_hash::prime_growth_policy::address_region(100, 0.86), 83);
+    EXPECT_EQ(
+        coalesced_hash::power_of_two_growth_policy::address_region(100, 0.86),
+        64);
+    coalesced_hash::coalesced_map<int, int> cmap_(100);
+    cmap_.max_load_factor(0.5);
+    for(int i = 0; i < 51; ++i)
+        cmap_.insert({i, i});
+    EXPECT_EQ(cmap_.bucket_count(), 200);
+}
+
+TEST(coalesced_hashtable_test, try_insert_no_grow) {
+    using coalesced_hash::coalesced_insert_status;
+    coalesced_hash::coalesced_map<int, int> cmap_(10);
+    // 0, 8 and 16 share home slot 0, 7 and 15 share slot 7
+    for(auto key : {0, 8, 7, 15}) {
+        EXPECT_EQ(
+            cmap_.try_insert_no_grow({key, key}).second,
+            coalesced_insert_status::inserted);
+    }
+    EXPECT_EQ(
+        cmap_.try_insert_no_grow({16, 16}, 0).second,
+        coalesced_insert_status::chain_too_long);
+    // cellar is used up, free slot search has to skip slot 7
+    EXPECT_EQ(
+        cmap_.try_insert_no_grow({16, 16}, 1, 0).second,
+        coalesced_insert_status::probe_limit);
+    EXPECT_EQ(
+        cmap_.try_insert_no_grow({16, 16}, 1, 0).second,
+        coalesced_insert_status::inserted);
+    for(int i = 1; i < 6; ++i)
+        cmap_.try_insert_no_grow({i, i});
+    EXPECT_EQ(
+        cmap_.try_insert_no_grow({6, 6}).second,
+        coalesced_insert_status::table_full);
+    EXPECT_EQ(cmap_.bucket_count(), 10);
+    EXPECT_EQ(cmap_.size(), 10);
+    EXPECT_EQ(cmap_.insert({24, 24}).second, true);
+    EXPECT_EQ(cmap_.bucket_count(), 20);
+}
+
+TEST(coalesced_hashtable_test, packed_header) {
+    using packed_traits = coalesced_hash::packed_address_node_traits;
+    using packed_map_t = coalesced_hash::coalesced_map<
+        uint16_t, uint16_t, std::hash<uint16_t>, std::equal_to<uint16_t>,
+        std::allocator<std::pair<const uint16_t, uint16_t>>, false,
+        coalesced_hash::doubling_growth_policy, packed_traits>;
+    EXPECT_EQ(sizeof(coalesced_hash::packed_address_node_t), 6);
+    EXPECT_EQ(
+        (sizeof(coalesced_hash::ch_node_t<
+                uint16_t, uint16_t, coalesced_hash::packed_address_node_t>)),
+        10);
+    packed_map_t cmap_(16);
+    for(uint16_t i = 0; i < 300; ++i)
+        cmap_.insert({uint16_t(i * 3), i});
+    EXPECT_EQ(cmap_.erase(uint16_t(3)), 1);
+    for(uint16_t i = 2; i < 300; ++i)
+        ASSERT_EQ(cmap_.find(uint16_t(i * 3))->value.second, i);
+    EXPECT_EQ(cmap_.find(uint16_t(3)) == cmap_.end(), true);
+    coalesced_hash::packed_address_node_t header;
+    packed_traits::set_prev(&header, packed_traits::max_capacity);
+    packed_traits::set_tail(&header);
+    packed_traits::set_next(&header, 42);
+    EXPECT_EQ(packed_traits::prev(&header), packed_traits::max_capacity);
+    EXPECT_EQ(packed_traits::next(&header), 42);
+    EXPECT_EQ(packed_traits::is_tail(&header), true);
+    EXPECT_EQ(packed_traits::is_head(&header), false);
+
+    // tables stop at the 22-bit link limit instead of wrapping links
+    packed_map_t large(5000000);
+    EXPECT_EQ(large.bucket_count(), packed_traits::max_capacity);
+    large.rehash(16);
+    for(uint16_t i = 0; i < 1000; ++i)
+        large.insert({i, uint16_t(i + 1)});
+    large.reserve(6000000);
+    EXPECT_EQ(large.bucket_count(), packed_traits::max_capacity);
+    large.rehash(UINT32_MAX - 2);
+    EXPECT_EQ(large.bucket_count(), packed_traits::max_capacity);
+    for(uint16_t i = 0; i < 1000; ++i)
+        ASSERT_EQ(large.find(i)->value.second, i + 1);
+    size_t count = 0;
+    for(auto iter = large.begin(); iter != large.end() && count <= 1000;
+        ++iter)
+        ++count;
+    EXPECT_EQ(count, 1000);
+
+    // a table at the limit fills up and then reports table_full
+    using packed_int_map_t = coalesced_hash::coalesced_map<
+        int, int, std::hash<int>, std::equal_to<int>,
+        std::allocator<std::pair<const int, int>>, false,
+        coalesced_hash::doubling_growth_policy, packed_traits>;
+    packed_int_map_t full(8);
+    int limit = int(packed_traits::max_capacity);
+    for(int i = 0; i < limit; ++i)
+        ASSERT_TRUE(full.insert({i, i}).second);
+    EXPECT_FALSE(full.insert({limit, 0}).second);
+    EXPECT_EQ(
+        full.try_insert_no_grow({limit, 0}).second,
+        coalesced_hash::coalesced_insert_status::table_full);
+    EXPECT_EQ(full.bucket_count(), packed_traits::max_capacity);
+    EXPECT_EQ(full.find(limit - 1)->value.second, limit - 1);
+}
+
+TEST(coalesced_hashtable_test, singly_linked_chains) {
+    using singly_traits = coalesced_hash::singly_address_node_traits;
+    using singly_map_t = coalesced_hash::coalesced_map<
+        int, int, std::hash<int>, std::equal_to<int>,
+        std::allocator<std::pair<const int, int>>, false,
+        coalesced_hash::doubling_growth_policy, singly_traits>;
+    EXPECT_EQ(
+        (sizeof(coalesced_hash::ch_node_t<
+                int, int, coalesced_hash::singly_address_node_t>)),
+        12);
+    singly_map_t cmap_(32, coalesced_hash::coalesced_insertion_mode::EICH);
+    EXPECT_EQ(cmap_.begin() == cmap_.end(), true);
+    for(int i = 0; i < 100; ++i)
+        cmap_.insert({i * 4, i});
+    EXPECT_EQ(std::distance(cmap_.begin(), cmap_.end()), 100);
+    EXPECT_EQ(cmap_.erase(8), 1);
+    EXPECT_EQ(
+        coalesced_hash::erase_if(
+            cmap_, [](const auto& value) { return value.second >= 50; }),
+        50);
+    int sum = 0;
+    for(auto& node : cmap_)
+        sum += node.value.second;
+    EXPECT_EQ(sum, 49 * 50 / 2 - 2);
+    for(int i = 0; i < 50; ++i)
+        EXPECT_EQ(cmap_.find(i * 4) == cmap_.end(), i == 2);
+}
+
+namespace {
+// no default constructor, live counts values not yet destroyed
+struct tracked_value {
+    static inline int live = 0;
+    explicit tracked_value(int v) : value(v) {
+        ++live;
+    }
+    tracked_value(const tracked_value& other) : value(other.value) {
+        ++live;
+    }
+    tracked_value& operator=(const tracked_value&) = default;
+    ~tracked_value() {
+        --live;
+    }
+    int value;
+};
+} // namespace
+
+TEST(coalesced_hashtable_test, split_value_layout) {
+    using big_value_t = std::array<uint64_t, 25>;
+    using split_map_t = coalesced_hash::coalesced_map<
+        int, big_value_t, std::hash<int>, std::equal_to<int>,
+        std::allocator<std::pair<const int, big_value_t>>, false,
+        coalesced_hash::doubling_growth_policy,
+        coalesced_hash::address_node_traits,
+        coalesced_hash::split_value_layout>;
+    EXPECT_EQ(sizeof(coalesced_hash::ch_key_node_t<int>), 12);
+    split_map_t cmap_(16);
+    for(int i = 0; i < 100; ++i) {
+        big_value_t value{};
+        value[24] = uint64_t(i);
+        cmap_.insert({i * 2, value});
+    }
+    EXPECT_EQ(cmap_.erase(10), 1);
+    for(int i = 0; i < 100; ++i) {
+        auto iter = cmap_.find(i * 2);
+        ASSERT_EQ(iter == cmap_.end(), i == 5);
+        if(i != 5) {
+            EXPECT_EQ(iter->value.second[24], uint64_t(i));
+        }
+    }
+    cmap_.find(4)->value.second[0] = 42;
+    EXPECT_EQ((*cmap_.find(4)).value.second[0], 42);
+    uint64_t sum = 0;
+    for(auto&& ref : cmap_)
+        sum += ref.value.second[24];
+    EXPECT_EQ(sum, 99 * 100 / 2 - 5);
+
+    // mapped values without default constructor, every constructed value
+    // is destroyed exactly once
+    using tracked_map_t = coalesced_hash::coalesced_map<
+        int, tracked_value, std::hash<int>, std::equal_to<int>,
+        std::allocator<std::pair<const int, tracked_value>>, false,
+        coalesced_hash::doubling_growth_policy,
+        coalesced_hash::address_node_traits,
+        coalesced_hash::split_value_layout>;
+    {
+        tracked_map_t tracked(4);
+        for(int i = 0; i < 100; ++i)
+            EXPECT_TRUE(tracked.try_emplace(i, i).second);
+        EXPECT_EQ(tracked.find(42)->value.second.value, 42);
+        for(int i = 0; i < 100; ++i)
+            EXPECT_EQ(tracked.erase(i), 1);
+        EXPECT_TRUE(tracked.empty());
+        EXPECT_TRUE(tracked.try_emplace(7, 7).second);
+    }
+    EXPECT_EQ(tracked_value::live, 0);
+}
+
+TEST(coalesced_hashtable_test, pooled_value_layout) {
+    using counter_t = std::atomic<int>;
+    using pooled_map_t = coalesced_hash::coalesced_map<
+        int, counter_t, std::hash<int>, std::equal_to<int>,
+        std::allocator<std::pair<const int, counter_t>>, false,
+        coalesced_hash::doubling_growth_policy,
+        coalesced_hash::address_node_traits,
+        coalesced_hash::pooled_value_layout>;
+    pooled_map_t cmap_(4);
+    EXPECT_TRUE(cmap_.try_emplace(0, 100).second);
+    counter_t* first = &cmap_.find(0)->value.second;
+    for(int i = 1; i < 200; ++i)
+        EXPECT_TRUE(cmap_.try_emplace(i, i).second);
+    EXPECT_FALSE(cmap_.try_emplace(0, 7).second);
+    EXPECT_EQ(cmap_.erase(1), 1);
+    EXPECT_EQ(cmap_.erase(2), 1);
+    // mapped values are never moved by growth or chain repair
+    EXPECT_EQ(&cmap_.find(0)->value.second, first);
+    EXPECT_EQ(cmap_.find(0)->value.second.load(), 100);
+    for(int i = 3; i < 200; ++i)
+        EXPECT_EQ(cmap_.find(i)->value.second.load(), i);
+    ++cmap_.find(5)->value.second;
+    EXPECT_EQ(cmap_.find(5)->value.second.load(), 6);
+}
+
+TEST(coalesced_hashtable_test, stable_references) {
+    using stable_map_t = coalesced_hash::coalesced_stable_map<int, std::string>;
+    EXPECT_TRUE(stable_map_t::stable_references);
+    EXPECT_FALSE((coalesced_hash::coalesced_map<int, int>::stable_references));
+    stable_map_t cmap_(4);
+    std::vector<std::string*> refs;
+    for(int i = 0; i < 64; ++i) {
+        cmap_.insert({i, std::to_string(i)});
+        refs.push_back(&cmap_.find(i)->value.second);
+    }
+    for(int i = 0; i < 64; i += 2)
+        EXPECT_EQ(cmap_.erase(i), 1);
+    cmap_.shrink_to_fit();
+    for(int i = 1; i < 64; i += 2) {
+        EXPECT_EQ(&cmap_.find(i)->value.second, refs[i]);
+        EXPECT_EQ(*refs[i], std::to_string(i));
+    }
+}
+
+TEST(coalesced_hashtable_test, find_bulk) {
+    using split_map_t = coalesced_hash::coalesced_map<
+        uint32_t, int, std::hash<uint32_t>, std::equal_to<uint32_t>,
+        std::allocator<std::pair<const uint32_t, int>>, false,
+        coalesced_hash::doubling_growth_policy,
+        coalesced_hash::address_node_traits,
+        coalesced_hash::split_value_layout>;
+    split_map_t cmap_(16);
+    coalesced_hash::coalesced_map<std::string, int> smap_(16);
+    for(uint32_t i = 0; i < 300; ++i) {
+        cmap_.insert({i * 3, int(i)});
+        smap_.insert({std::to_string(i * 3), int(i)});
+    }
+    std::vector<uint32_t> keys;
+    std::vector<std::string> skeys;
+    for(uint32_t i = 0; i < 899; i += 2) {
+        keys.push_back(i);
+        skeys.push_back(std::to_string(i));
+    }
+    auto found = std::vector<decltype(cmap_.end())>(keys.size(), cmap_.end());
+    cmap_.find_bulk(keys.data(), keys.size(), found.data());
+    auto sfound = std::vector<decltype(smap_.end())>(skeys.size(), smap_.end());
+    smap_.find_bulk(skeys.data(), skeys.size(), sfound.data());
+    for(size_t i = 0; i < keys.size(); ++i) {
+        EXPECT_TRUE(found[i] == cmap_.find(keys[i]));
+        EXPECT_EQ(found[i] == cmap_.end(), keys[i] % 3 != 0);
+        EXPECT_TRUE(sfound[i] == smap_.find(skeys[i]));
+    }
+}
+
+TEST(coalesced_hashtable_test, hash_join) {
+    std::vector<std::pair<int, int>> build;
+    for(int i = 0; i < 1000; ++i)
+        build.push_back({i % 250, i});
+    coalesced_hash::coalesced_join<int, int> join;
+    join.build(build.begin(), build.end(), 4);
+    EXPECT_EQ(join.size(), 1000);
+    std::vector<int> keys;
+    for(int i = 0; i < 500; i += 5)
+        keys.push_back(i);
+    join.probe(keys.data(), keys.size());
+    // buffer smaller than matches of one key, pass has to resume
+    std::array<coalesced_hash::coalesced_join_match<int, int>, 3> buffer;
+    std::vector<int> matches(keys.size());
+    size_t total = 0;
+    while(auto written = join.next(buffer.data(), buffer.size())) {
+        for(size_t i = 0; i < written; ++i) {
+            EXPECT_EQ(buffer[i].build->first, keys[buffer[i].probe_index]);
+            EXPECT_EQ(buffer[i].build->second % 250, buffer[i].build->first);
+            ++matches[buffer[i].probe_index];
+        }
+        total += written;
+    }
+    EXPECT_EQ(total, 50 * 4);
+    for(size_t i = 0; i < keys.size(); ++i)
+        EXPECT_EQ(matches[i], keys[i] < 250 ? 4 : 0);
+    // a single map probes straight from the key array
+    join.build(build.begin(), build.end());
+    join.probe(keys.data(), keys.size());
+    total = 0;
+    while(auto written = join.next(buffer.data(), buffer.size()))
+        total += written;
+    EXPECT_EQ(total, 50 * 4);
+}
+
+TEST(coalesced_hashtable_test, aggregator) {
+    using sum_t = coalesced_hash::sum_aggregate<int64_t>;
+    std::vector<int> keys;
+    std::vector<int64_t> values;
+    std::unordered_map<int, int64_t> expected;
+    for(int i = 0; i < 20000; ++i) {
+        keys.push_back((i * 7919) % 1237);
+        values.push_back(i);
+        expected[keys.back()] += i;
+    }
+    coalesced_hash::coalesced_aggregator<int, sum_t> serial;
+    serial.add_batch(keys.data(), values.data(), keys.size());
+    coalesced_hash::coalesced_aggregator<int, sum_t> parallel;
+    parallel.add_parallel(keys.data(), values.data(), keys.size(), 4);
+    EXPECT_EQ(serial.size(), expected.size());
+    EXPECT_EQ(parallel.size(), expected.size());
+    for(auto& group : expected) {
+        ASSERT_NE(serial.find(group.first), nullptr);
+        EXPECT_EQ(serial.find(group.first)->value, group.second);
+        EXPECT_EQ(parallel.find(group.first)->value, group.second);
+    }
+    EXPECT_EQ(serial.find(5000), nullptr);
+    coalesced_hash::coalesced_map<int, int> cmap_(8);
+    EXPECT_TRUE(cmap_.try_emplace(1, 10).second);
+    EXPECT_FALSE(cmap_.try_emplace(1, 20).second);
+    EXPECT_EQ(cmap_.size(), 1);
+    EXPECT_EQ(cmap_.find(1)->value.second, 10);
+    coalesced_hash::coalesced_map<int, int> emap_(
+        8, coalesced_hash::coalesced_insertion_mode::EICH);
+    for(int i = 0; i < 200; ++i)
+        emap_.try_emplace(i % 50, i);
+    EXPECT_EQ(emap_.size(), 50);
+    for(int i = 0; i < 50; ++i)
+        EXPECT_EQ(emap_.find(i)->value.second, i);
+    // update of a present key at the load threshold keeps the table
+    coalesced_hash::coalesced_map<int, int> full_(100);
+    full_.max_load_factor(0.5);
+    for(int i = 0; i < 50; ++i)
+        full_.insert({i, i});
+    ASSERT_EQ(full_.bucket_count(), 100);
+    int* value = &full_.find(7)->value.second;
+    auto result = full_.try_emplace(7, 70);
+    EXPECT_FALSE(result.second);
+    EXPECT_EQ(full_.bucket_count(), 100);
+    EXPECT_EQ(&result.first->value.second, value);
+    EXPECT_EQ(*value, 7);
+}
+
+TEST(coalesced_hashtable_test, partitioned_build) {
+    std::vector<std::pair<int, int>> rows;
+    for(int i = 0; i < 50000; ++i)
+        rows.push_back({i * 31, i});
+    coalesced_hash::coalesced_map<int, int> cmap_(8);
+    cmap_.insert({-1, -1});
+    cmap_.build(rows.begin(), rows.end());
+    EXPECT_EQ(cmap_.size(), rows.size() + 1);
+    EXPECT_EQ(cmap_.find(-1)->value.second, -1);
+    for(auto& row : rows)
+        ASSERT_EQ(cmap_.find(row.first)->value.second, row.second);
+}
+
+TEST(coalesced_hashtable_test, segmented_map) {
+    coalesced_hash::coalesced_segmented_map<int, int> smap_(3, 16);
+    EXPECT_EQ(smap_.segment_count(), 8);
+    EXPECT_TRUE(smap_.begin() == smap_.end());
+    for(int i = 0; i < 2000; ++i)
+        EXPECT_TRUE(smap_.insert({i, i * 2}).second);
+    EXPECT_FALSE(smap_.try_emplace(5, 0).second);
+    EXPECT_EQ(smap_.size(), 2000);
+    for(size_t i = 0; i < smap_.segment_count(); ++i) {
+        // every segment grew on its own
+        EXPECT_GT(smap_.segment(i).size(), 0);
+        EXPECT_GT(smap_.segment(i).bucket_count(), 16);
+    }
+    EXPECT_EQ(smap_.erase(7), 1);
+    EXPECT_TRUE(smap_.find(7) == smap_.end());
+    EXPECT_EQ(smap_.find(8)->value.second, 16);
+    EXPECT_EQ(smap_.find(8).segment(), smap_.segment_index(8));
+    auto iter = smap_.find(8);
+    iter = smap_.find(9);
+    EXPECT_EQ(iter->value.second, 18);
+    int64_t sum = 0;
+    size_t count = 0;
+    for(auto& node : smap_) {
+        sum += node.value.first;
+        ++count;
+    }
+    EXPECT_EQ(count, 1999);
+    EXPECT_EQ(sum, 1999 * 2000 / 2 - 7);
+}
+
+TEST(coalesced_hashtable_test, extendible_growth) {
+    coalesced_hash::coalesced_segmented_map<int, int> smap_(0, 64);
+    smap_.max_segment_capacity(64);
+    for(int i = 0; i < 5000; ++i)
+        ASSERT_TRUE(smap_.insert({i, -i}).second);
+    EXPECT_FALSE(smap_.try_emplace(10, 0).second);
+    EXPECT_TRUE(smap_.try_emplace(5000, 1).second);
+    EXPECT_EQ(smap_.erase(5000), 1);
+    EXPECT_EQ(smap_.size(), 5000);
+    EXPECT_GT(smap_.segment_count(), 5000 / 64);
+    EXPECT_GE(size_t(1) << smap_.global_depth(), smap_.segment_count());
+    // segments never grow past the limit, they split instead
+    for(size_t i = 0; i < smap_.segment_count(); ++i)
+        EXPECT_EQ(smap_.segment(i).bucket_count(), 64);
+    for(int i = 0; i < 5000; ++i)
+        ASSERT_EQ(smap_.find(i)->value.second, -i);
+    size_t count = 0;
+    for(auto iter = smap_.begin(); iter != smap_.end(); ++iter)
+        ++count;
+    EXPECT_EQ(count, 5000);
+
+    // a limit off the doubling sequence caps growth instead of passing it
+    coalesced_hash::coalesced_segmented_map<int, int> capped(0, 48);
+    capped.max_segment_capacity(100);
+    for(int i = 0; i < 3000; ++i)
+        ASSERT_TRUE(capped.try_emplace(i, -i).second);
+    EXPECT_FALSE(capped.try_emplace(10, 0).second);
+    EXPECT_GT(capped.segment_count(), 3000 / 100);
+    for(size_t i = 0; i < capped.segment_count(); ++i)
+        EXPECT_EQ(capped.segment(i).bucket_count(), 100);
+    for(int i = 0; i < 3000; ++i)
+        ASSERT_EQ(capped.find(i)->value.second, -i);
+}
+
+#if defined(__cpp_impl_coroutine)
+template<class Map>
+coalesced_hash::coalesced_task lookup_sum(
+    coalesced_hash::coalesced_scheduler& scheduler, Map& map, int first,
+    int64_t& sum) {
+    for(int key = first; key < 1000; key += 8) {
+        auto iter = co_await scheduler.find(map, key);
+        if(iter != map.end())
+            sum += iter->value.second;
+    }
+}
+#endif
+
+TEST(coalesced_hashtable_test, interleaved_find) {
+    coalesced_hash::coalesced_map<int, int> cmap_(8);
+    for(int i = 0; i < 500; ++i)
+        cmap_.insert({i, i});
+    auto state = cmap_.find_begin(42);
+    while(!cmap_.find_step(state)) {
+    }
+    EXPECT_TRUE(cmap_.find_result(state) == cmap_.find(42));
+    state = cmap_.find_begin(600);
+    while(!cmap_.find_step(state)) {
+    }
+    EXPECT_TRUE(cmap_.find_result(state) == cmap_.end());
+#if defined(__cpp_impl_coroutine)
+    coalesced_hash::coalesced_scheduler scheduler;
+    int64_t sum = 0;
+    for(int lane = 0; lane < 8; ++lane)
+        scheduler.spawn(lookup_sum(scheduler, cmap_, lane, sum));
+    scheduler.run();
+    EXPECT_EQ(sum, 499 * 500 / 2);
+#endif
+}
+
+TEST(coalesced_hashtable_test, async_rehash) {
+    coalesced_hash::coalesced_async_map<int, std::string> amap_(64, 0.5);
+    for(int i = 0; i < 32; ++i)
+        EXPECT_TRUE(amap_.insert({i, std::to_string(i)}));
+    EXPECT_FALSE(amap_.rehashing());
+    // crossing the threshold freezes the table
+    EXPECT_TRUE(amap_.insert({32, "32"}));
+    EXPECT_TRUE(amap_.rehashing());
+    EXPECT_FALSE(amap_.insert({5, "x"}));
+    EXPECT_EQ(amap_.erase(3), 1);
+    EXPECT_EQ(amap_.erase(32), 1);
+    EXPECT_EQ(amap_.erase(3), 0);
+    EXPECT_EQ(amap_.find(3), nullptr);
+    EXPECT_TRUE(amap_.insert({3, "three"}));
+    EXPECT_EQ(*amap_.find(5), "5");
+    amap_.wait();
+    EXPECT_FALSE(amap_.rehashing());
+    EXPECT_EQ(amap_.bucket_count(), 128);
+    EXPECT_EQ(amap_.size(), 32);
+    EXPECT_EQ(*amap_.find(3), "three");
+    EXPECT_EQ(amap_.find(32), nullptr);
+    for(int i = 33; i < 2000; ++i)
+        EXPECT_TRUE(amap_.insert({i, std::to_string(i)}));
+    amap_.wait();
+    EXPECT_EQ(amap_.size(), 2000 - 1);
+    for(int i = 33; i < 2000; ++i)
+        ASSERT_EQ(*amap_.find(i), std::to_string(i));
+
+    // writes through find during a rehash survive the switch over
+    coalesced_hash::coalesced_async_map<int, int> counters(1024, 0.5);
+    for(int i = 0; i < 512; ++i)
+        counters.insert({i, 0});
+    EXPECT_TRUE(counters.insert({512, 0}));
+    ASSERT_TRUE(counters.rehashing());
+    for(int round = 0; round < 3; ++round) {
+        for(int i = 0; i <= 512; ++i)
+            *counters.find(i) += i;
+    }
+    const auto& frozen = counters;
+    EXPECT_EQ(*frozen.find(100), 300);
+    counters.wait();
+    EXPECT_EQ(counters.size(), 513);
+    for(int i = 0; i <= 512; ++i)
+        ASSERT_EQ(*counters.find(i), 3 * i);
+}
+
+TEST(coalesced_hashtable_test, snapshot) {
+    coalesced_hash::coalesced_map<int, std::string> cmap_(4000);
+    for(int i = 0; i < 3000; ++i)
+        cmap_.insert({i, std::to_string(i)});
+    auto sum = [](const auto& snap) {
+        int64_t result = 0;
+        snap.for_each([&result](const int& key, const std::string& value) {
+            EXPECT_EQ(value, std::to_string(key));
+            result += key;
+        });
+        return result;
+    };
+    {
+        auto snap = cmap_.make_snapshot();
+        EXPECT_EQ(snap.size(), 3000);
+        cmap_.erase(10);
+        cmap_.insert({5000, "5000"});
+        EXPECT_EQ(sum(snap), 2999 * 3000 / 2);
+        // growth copies the remaining pages
+        for(int i = 3000; i < 5000; ++i)
+            cmap_.insert({i, std::to_string(i)});
+        EXPECT_EQ(sum(snap), 2999 * 3000 / 2);
+        auto next = cmap_.make_snapshot();
+        EXPECT_EQ(sum(next), 5000 * 5001 / 2 - 10);
+    }
+    // no live snapshots, writes copy nothing
+    cmap_.erase(11);
+    EXPECT_EQ(sum(cmap_.make_snapshot()), 5000 * 5001 / 2 - 21);
+    // mapped values changed in place through lookups and iteration
+    {
+        auto snap = cmap_.make_snapshot();
+        cmap_.find(42)->value.second = "updated";
+        cmap_.try_emplace(4042).first->value.second = "updated";
+        for(auto iter = cmap_.begin(); iter != cmap_.end(); ++iter)
+            iter->value.second += "!";
+        EXPECT_EQ(sum(snap), 5000 * 5001 / 2 - 21);
+    }
+    EXPECT_EQ(cmap_.find(42)->value.second, "updated!");
+    EXPECT_EQ(cmap_.find(4042)->value.second, "updated!");
+}
+
+TEST(coalesced_hashtable_test, change_log) {
+    using map_t = coalesced_hash::coalesced_map<int, int>;
+    coalesced_hash::coalesced_change_log<int, int> log(1024);
+    map_t cmap_(64);
+    cmap_.attach_change_log(&log);
+    for(int i = 0; i < 40; ++i)
+        cmap_.insert({i, i});
+    std::stringstream image;
+    cmap_.save_image(image);
+    std::stringstream stream;
+    log.drain_to(stream);
+    for(int i = 40; i < 50; ++i)
+        cmap_.insert({i, i});
+    cmap_.erase(3);
+    auto iter = cmap_.find(7);
+    iter->value.second = 70;
+    cmap_.log_update(iter);
+    EXPECT_EQ(log.size(), 12);
+    log.drain_to(stream);
+    EXPECT_FALSE(log.overflowed());
+
+    map_t recovered(8);
+    auto bytes = image.str();
+    uint64_t sequence = 0;
+    ASSERT_TRUE(recovered.load_image(bytes.data(), bytes.size(), &sequence));
+    EXPECT_EQ(sequence, 40);
+    EXPECT_EQ(recovered.size(), 40);
+    EXPECT_EQ(recovered.bucket_count(), 64);
+    EXPECT_EQ(recovered.apply_log(stream, sequence), 12);
+    EXPECT_EQ(recovered.size(), 49);
+    EXPECT_TRUE(recovered.find(3) == recovered.end());
+    EXPECT_EQ(recovered.find(7)->value.second, 70);
+    for(int i = 40; i < 50; ++i)
+        EXPECT_EQ(recovered.find(i)->value.second, i);
+    EXPECT_FALSE(recovered.load_image(bytes.data(), bytes.size() - 1));
+
+    // erases of duplicated keys replay slot by slot
+    for(uint32_t seed = 0; seed < 50; ++seed) {
+        coalesced_hash::coalesced_change_log<int, int> dup_log(4096);
+        map_t primary(32);
+        primary.attach_change_log(&dup_log);
+        std::stringstream dup_image;
+        primary.save_image(dup_image);
+        uint32_t state = seed * 2654435761u + 1;
+        auto next = [&state]() {
+            state = state * 1103515245u + 12345u;
+            return (state >> 16) % 40;
+        };
+        for(int step = 0; step < 300; ++step) {
+            auto key = int(next());
+            if(step % 7 == 3) {
+                primary.erase_if([key](const auto& value) {
+                    return value.first % 5 == key % 5 && value.second & 1;
+                });
+            }
+            else if(step % 5 == 1) {
+                primary.erase(key);
+            }
+            else {
+                primary.insert({key, step});
+            }
+        }
+        std::stringstream dup_stream;
+        dup_log.drain_to(dup_stream);
+        map_t replica(8);
+        auto dup_bytes = dup_image.str();
+        ASSERT_TRUE(replica.load_image(dup_bytes.data(), dup_bytes.size()));
+        ASSERT_GE(replica.apply_log(dup_stream, 0), 0);
+        std::ostringstream left, right;
+        primary.save_image(left);
+        replica.save_image(right);
+        // same elements in the same slots, headers differ in log sequence
+        auto header_size = sizeof(coalesced_hash::ch_image_header_t);
+        ASSERT_EQ(replica.size(), primary.size()) << "seed " << seed;
+        ASSERT_EQ(
+            left.str().substr(header_size), right.str().substr(header_size))
+            << "seed " << seed;
+    }
+}
+
+TEST(coalesced_hashtable_test, compressed_image) {
+    coalesced_hash::coalesced_map<int, int> cmap_(8);
+    for(int i = 0; i < 20000; ++i)
+        cmap_.insert({i * 3, i & 0xFF});
+    for(int i = 0; i < 20000; i += 7)
+        cmap_.erase(i * 3);
+    std::ostringstream raw, packed;
+    cmap_.save_image(raw);
+    coalesced_hash::save_compressed(cmap_, packed, 1024);
+    EXPECT_LT(packed.str().size() * 3, raw.str().size());
+    auto bytes = packed.str();
+    coalesced_hash::coalesced_map<int, int> loaded(8);
+    ASSERT_TRUE(coalesced_hash::load_compressed(
+        loaded, bytes.data(), bytes.size(), 4));
+    EXPECT_EQ(loaded.size(), cmap_.size());
+    for(int i = 0; i < 20000; ++i) {
+        auto iter = loaded.find(i * 3);
+        ASSERT_EQ(iter == loaded.end(), i % 7 == 0);
+        if(i % 7 != 0) {
+            EXPECT_EQ(iter->value.second, i & 0xFF);
+        }
+    }
+    std::ostringstream again;
+    loaded.save_image(again);
+    EXPECT_EQ(again.str(), raw.str());
+    bytes[bytes.size() / 2] ^= 0x55;
+    bytes.pop_back();
+    EXPECT_FALSE(coalesced_hash::load_compressed(
+        loaded, bytes.data(), bytes.size(), 2));
+}
+
+TEST(coalesced_hashtable_test, map_view) {
+    coalesced_hash::coalesced_map<uint32_t, uint64_t> cmap_(8);
+    for(uint32_t i = 0; i < 5000; ++i)
+        cmap_.insert({i * 5, uint64_t(i) << 20});
+    cmap_.erase(10);
+    std::ostringstream image;
+    cmap_.save_image(image);
+    auto bytes = image.str();
+    // receive buffer aligned for the nodes
+    std::vector<uint64_t> buffer((bytes.size() + 7) / 8);
+    std::memcpy(buffer.data(), bytes.data(), bytes.size());
+
+    coalesced_hash::coalesced_map_view<uint32_t, uint64_t> view;
+    EXPECT_TRUE(view.find(5) == view.end());
+    ASSERT_TRUE(view.attach(buffer.data(), bytes.size()));
+    EXPECT_EQ(view.size(), cmap_.size());
+    EXPECT_EQ(view.bucket_count(), cmap_.bucket_count());
+    EXPECT_TRUE(view.find(10) == view.end());
+    EXPECT_TRUE(view.find(7) == view.end());
+    EXPECT_EQ(view.find(25)->second, uint64_t(5) << 20);
+    size_t count = 0;
+    uint64_t sum = 0;
+    for(auto& value : view) {
+        ++count;
+        sum += value.second >> 20;
+    }
+    EXPECT_EQ(count, 4999);
+    EXPECT_EQ(sum, 4999ull * 5000 / 2 - 2);
+
+    std::vector<uint32_t> keys;
+    for(uint32_t i = 0; i < 1003; ++i)
+        keys.push_back(i * 3);
+    std::vector<decltype(view.end())> found(keys.size());
+    view.find_bulk(keys.data(), keys.size(), found.data());
+    for(size_t i = 0; i < keys.size(); ++i) {
+        bool present = keys[i] % 5 == 0 && keys[i] != 10;
+        ASSERT_EQ(found[i] != view.end(), present);
+        if(present) {
+            EXPECT_EQ(found[i]->first, keys[i]);
+        }
+    }
+
+    EXPECT_FALSE(view.attach(buffer.data(), bytes.size() - 1));
+    EXPECT_FALSE(view.attached());
+    std::vector<uint64_t> shifted(buffer.size() + 1);
+    auto misaligned = reinterpret_cast<char*>(shifted.data()) + 4;
+    std::memcpy(misaligned, bytes.data(), bytes.size());
+    EXPECT_FALSE(view.attach(misaligned, bytes.size()));
+
+    // corrupted links closing every chain into a cycle end walks as misses
+    using view_t = coalesced_hash::coalesced_map_view<uint32_t, uint64_t>;
+    auto nodes = reinterpret_cast<view_t::node_type*>(
+        reinterpret_cast<char*>(buffer.data())
+        + sizeof(coalesced_hash::ch_image_header_t));
+    for(uint32_t pos = 0; pos < cmap_.bucket_count(); ++pos) {
+        if(view_t::node_traits::is_allocated(nodes + pos)) {
+            view_t::node_traits::reset_tail(nodes + pos);
+            view_t::node_traits::set_next(nodes + pos, pos);
+        }
+    }
+    ASSERT_TRUE(view.attach(buffer.data(), bytes.size()));
+    EXPECT_FALSE(view.verify());
+    // absent keys sharing home slots with present ones
+    coalesced_hash::ch_image_header_t header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    std::vector<uint32_t> missing;
+    for(uint32_t i = 1; i < 100; ++i)
+        missing.push_back(i * 5 + 4 * header.address_region);
+    std::vector<decltype(view.end())> misses(missing.size());
+    view.find_bulk(missing.data(), missing.size(), misses.data());
+    for(size_t i = 0; i < missing.size(); ++i)
+        EXPECT_TRUE(misses[i] == view.end());
+    EXPECT_TRUE(view.find(missing[0]) == view.end());
+}
+
+namespace {
+struct seeded_hasher {
+    static constexpr uint64_t hash_id = 7;
+    static constexpr uint64_t hash_seed = 42;
+    size_t operator()(int key) const {
+        return std::hash<int>{}(key ^ int(hash_seed));
+    }
+};
+} // namespace
+
+TEST(coalesced_hashtable_test, image_format) {
+    using map_t = coalesced_hash::coalesced_map<int, int>;
+    map_t cmap_(64);
+    for(int i = 0; i < 40; ++i)
+        cmap_.insert({i, i});
+    std::ostringstream image;
+    cmap_.save_image(image);
+    auto bytes = image.str();
+    coalesced_hash::ch_image_header_t header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    EXPECT_EQ(header.magic, coalesced_hash::ch_image_magic);
+    EXPECT_EQ(header.version, coalesced_hash::ch_image_version);
+    EXPECT_EQ(header.node_align, alignof(int));
+    EXPECT_EQ(header.address_factor, 0.86);
+    EXPECT_TRUE(map_t::image_compatible(bytes.data(), bytes.size()));
+
+    // other hash function, other node layout
+    using seeded_t = coalesced_hash::coalesced_map<int, int, seeded_hasher>;
+    EXPECT_FALSE(seeded_t::image_compatible(bytes.data(), bytes.size()));
+    seeded_t seeded(8);
+    EXPECT_FALSE(seeded.load_image(bytes.data(), bytes.size()));
+    EXPECT_EQ(seeded_t::image_signature().hash_seed, 42);
+    using wide_t = coalesced_hash::coalesced_map<int, int64_t>;
+    EXPECT_FALSE(wide_t::image_compatible(bytes.data(), bytes.size()));
+    // same nodes, but buckets are masked instead of taken modulo
+    using masked_t = coalesced_hash::coalesced_map<
+        int, int, std::hash<int>, std::equal_to<int>,
+        std::allocator<std::pair<const int, int>>, false,
+        coalesced_hash::power_of_two_growth_policy>;
+    EXPECT_FALSE(masked_t::image_compatible(bytes.data(), bytes.size()));
+    coalesced_hash::coalesced_map_view<
+        int, int, std::hash<int>, std::equal_to<int>,
+        coalesced_hash::power_of_two_growth_policy>
+        masked_view;
+    std::vector<uint64_t> aligned((bytes.size() + 7) / 8);
+    std::memcpy(aligned.data(), bytes.data(), bytes.size());
+    EXPECT_FALSE(masked_view.attach(aligned.data(), bytes.size()));
+
+    // header is fine, table bytes are not
+    auto corrupted = bytes;
+    corrupted[sizeof(header) + 13] ^= 0x01;
+    EXPECT_TRUE(map_t::image_compatible(corrupted.data(), corrupted.size()));
+    map_t loaded(8);
+    EXPECT_FALSE(loaded.load_image(corrupted.data(), corrupted.size()));
+    std::vector<uint64_t> buffer((bytes.size() + 7) / 8);
+    std::memcpy(buffer.data(), corrupted.data(), corrupted.size());
+    coalesced_hash::coalesced_map_view<int, int> view;
+    ASSERT_TRUE(view.attach(buffer.data(), corrupted.size()));
+    EXPECT_FALSE(view.verify());
+    std::memcpy(buffer.data(), bytes.data(), bytes.size());
+    EXPECT_TRUE(view.verify());
+
+    // byte swapped writer
+    auto swapped = bytes;
+    header.endianness = 0x04030201;
+    std::memcpy(&swapped[0], &header, sizeof(header));
+    EXPECT_FALSE(map_t::image_compatible(swapped.data(), swapped.size()));
+    EXPECT_FALSE(view.attach(swapped.data(), swapped.size()));
+    ASSERT_TRUE(loaded.load_image(bytes.data(), bytes.size()));
+    EXPECT_EQ(loaded.find(17)->value.second, 17);
+}
+
+TEST(coalesced_hashtable_test, warm) {
+    using map_t = coalesced_hash::coalesced_map<uint32_t, uint64_t>;
+    map_t cmap_(8);
+    for(uint32_t i = 0; i < 100000; ++i)
+        cmap_.insert({i, i});
+    std::ostringstream image;
+    cmap_.save_image(image);
+    auto bytes = image.str();
+    map_t loaded(8);
+    ASSERT_TRUE(loaded.load_image(bytes.data(), bytes.size()));
+    EXPECT_GE(loaded.warm(4).count(), 0);
+    EXPECT_EQ(loaded.find(99999)->value.second, 99999);
+
+    std::vector<uint64_t> buffer((bytes.size() + 7) / 8);
+    std::memcpy(buffer.data(), bytes.data(), bytes.size());
+    coalesced_hash::coalesced_map_view<uint32_t, uint64_t> view;
+    EXPECT_EQ(view.warm(2).count(), 0);
+    ASSERT_TRUE(view.attach(buffer.data(), bytes.size()));
+    EXPECT_GE(view.warm(3).count(), 0);
+    EXPECT_EQ(view.find(4242)->second, 4242);
+
+    coalesced_hash::coalesced_stable_map<int, std::string> pooled(8);
+    for(int i = 0; i < 1000; ++i)
+        pooled.insert({i, std::to_string(i)});
+    EXPECT_GE(pooled.warm(2).count(), 0);
+    EXPECT_EQ(pooled.find(999)->value.second, "999");
+}
+
+namespace {
+// buckets of a 256 slot masked region hit by hashes of count keys
+template<class Hasher, class KeyOf>
+size_t masked_buckets_hit(Hasher hasher, size_t count, KeyOf key_of) {
+    std::vector<uint8_t> used(256);
+    for(size_t i = 0; i < count; ++i)
+        used[hasher(key_of(i)) & 0xFF] = 1;
+    return size_t(std::count(used.begin(), used.end(), 1));
+}
+} // namespace
+
+TEST(coalesced_hashtable_test, integer_keys) {
+    EXPECT_EQ((sizeof(coalesced_hash::ch_int_node_t<uint32_t, uint64_t>)), 16);
+    EXPECT_EQ((sizeof(coalesced_hash::ch_int_node_t<uint64_t, uint64_t>)), 24);
+    coalesced_hash::ch_int_node_t<uint32_t, uint64_t> node(
+        std::pair<uint32_t, uint64_t>(3, 30));
+    auto copy = node;
+    EXPECT_EQ(copy.key, 3);
+    EXPECT_EQ(copy.mapped, 30);
+    // keys on power of two strides hit every bucket of a masked region
+    coalesced_hash::ch_int_hasher<uint64_t> hasher;
+    for(uint32_t stride : {12, 33, 40, 48}) {
+        EXPECT_EQ(
+            masked_buckets_hit(
+                hasher, 4096, [stride](size_t i) { return i << stride; }),
+            256)
+            << stride;
+    }
+
+    using int_map_t = coalesced_hash::coalesced_int_map<uint32_t, uint64_t>;
+    int_map_t cmap_(8);
+    for(uint32_t i = 0; i < 20000; ++i)
+        EXPECT_TRUE(cmap_.insert({i << 12, i}).second);
+    EXPECT_FALSE(cmap_.try_emplace(4096, 7).second);
+    EXPECT_TRUE(cmap_.try_emplace(1, 7).second);
+    for(uint32_t i = 0; i < 20000; i += 3)
+        EXPECT_EQ(cmap_.erase(i << 12), 1);
+    uint64_t sum = 0;
+    for(auto&& ref : cmap_)
+        sum += ref.value.second;
+    uint64_t expected = 7;
+    for(uint32_t i = 0; i < 20000; ++i) {
+        auto iter = cmap_.find(i << 12);
+        ASSERT_EQ(iter == cmap_.end(), i % 3 == 0);
+        if(i % 3 != 0) {
+            EXPECT_EQ(iter->value.second, i);
+            expected += i;
+        }
+    }
+    EXPECT_EQ(sum, expected);
+    cmap_.find(1)->value.second = 8;
+    EXPECT_EQ(cmap_.find(1)->value.second, 8);
+    std::vector<uint32_t> keys = {1, 2, 4096, 8192, 12288};
+    std::vector<decltype(cmap_.end())> found(keys.size(), cmap_.end());
+    cmap_.find_bulk(keys.data(), keys.size(), found.data());
+    EXPECT_TRUE(found[0] != cmap_.end());
+    EXPECT_TRUE(found[1] == cmap_.end());
+    EXPECT_TRUE(found[2] != cmap_.end());
+    EXPECT_TRUE(found[3] != cmap_.end());
+    EXPECT_TRUE(found[4] == cmap_.end());
+}
+
+TEST(coalesced_hashtable_test, pointer_keys) {
+    struct alignas(16) object_t {
+        uint64_t id;
+    };
+    std::vector<object_t> objects(5000);
+    for(size_t i = 0; i < objects.size(); ++i)
+        objects[i].id = i;
+    // alignment bits are dropped before mixing
+    EXPECT_EQ(coalesced_hash::ch_pointer_shift<object_t>(), 4);
+    EXPECT_EQ(coalesced_hash::ch_pointer_shift<uint64_t>(), 3);
+    EXPECT_EQ(coalesced_hash::ch_pointer_shift<void>(), 0);
+    coalesced_hash::ch_ptr_hasher<object_t> hasher;
+    auto addr = reinterpret_cast<uintptr_t>(&objects[5]);
+    EXPECT_EQ(
+        hasher(&objects[5]),
+        coalesced_hash::ch_int_hasher<uintptr_t>{}(addr >> 4));
+    EXPECT_EQ(
+        masked_buckets_hit(
+            hasher, 4096, [&objects](size_t i) { return &objects[i]; }),
+        256);
+
+    coalesced_hash::coalesced_ptr_map<object_t, uint64_t> cmap_(8);
+    for(auto& object : objects)
+        cmap_.insert({&object, object.id});
+    EXPECT_EQ(cmap_.erase(&objects[7]), 1);
+    for(size_t i = 0; i < objects.size(); ++i) {
+        auto iter = cmap_.find(&objects[i]);
+        ASSERT_EQ(iter == cmap_.end(), i == 7);
+        if(i != 7) {
+            EXPECT_EQ(iter->value.second, i);
+        }
+    }
+
+    using codec_t = coalesced_hash::ch_pointer_codec<object_t>;
+    EXPECT_EQ(codec_t::shift, 4);
+    EXPECT_EQ(codec_t::range, uint64_t(64) << 30);
+    codec_t codec(objects.data());
+    EXPECT_FALSE(codec.fits(reinterpret_cast<const object_t*>(
+        reinterpret_cast<uintptr_t>(objects.data()) - sizeof(object_t))));
+    EXPECT_FALSE(codec.fits(reinterpret_cast<const object_t*>(
+        reinterpret_cast<const char*>(&objects[3]) + 8)));
+    EXPECT_EQ(
+        (sizeof(coalesced_hash::ch_int_node_t<
+                coalesced_hash::ch_compressed_ptr_t, uint64_t>)),
+        16);
+    coalesced_hash::coalesced_compressed_ptr_map<uint64_t> compressed(8);
+    for(auto& object : objects) {
+        ASSERT_TRUE(codec.fits(&object));
+        compressed.insert({codec.encode(&object), object.id});
+    }
+    EXPECT_EQ(codec.decode(codec.encode(&objects[42])), &objects[42]);
+    uint64_t sum = 0;
+    for(auto&& ref : compressed)
+        sum += codec.decode(ref.value.first)->id - ref.value.second;
+    EXPECT_EQ(sum, 0);
+    EXPECT_EQ(compressed.find(codec.encode(&objects[99]))->value.second, 99);
+}
+
 // TODO: performance tests
 
 int main(int argc, char* argv[]) {
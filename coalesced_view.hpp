@@ -0,0 +1,276 @@
+#pragma once
+// Read-only coalesced map over a saved table image in external memory
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#endif
+
+#include "coalesced_hashtable.hpp"
+
+namespace coalesced_hash {
+
+/** Map view
+ * Interprets a buffer holding an image written by coalesced_map::save_image
+ * (e.g. received over the wire or mmap'ed) as a read-only map, nothing is
+ * copied. The buffer has to be aligned to alignof(node_type) and outlive
+ * the view. Hasher, KeyEq, GrowthPolicy and HeaderTraits have to match
+ * the saving map. attach checks the image header and sizes only, verify
+ * checks the table against its checksum. Lookups bounds check chain links
+ * and give up after capacity hops, so a corrupted table without verify
+ * gives wrong answers but never hangs. */
+template<
+    class Key, class T, class Hasher = std::hash<Key>,
+    class KeyEq = std::equal_to<Key>,
+    class GrowthPolicy = doubling_growth_policy,
+    class HeaderTraits = address_node_traits>
+class coalesced_map_view {
+    static_assert(
+        std::is_trivially_copyable_v<Key> && std::is_trivially_copyable_v<T>,
+        "views read raw images of trivially copyable elements");
+
+public:
+    using key_type = Key;
+    using mapped_type = T;
+    using value_type = std::pair<const Key, T>;
+    using key_equal = KeyEq;
+    using hasher = Hasher;
+    using node_traits = ch_node_traits<Key, T, HeaderTraits>;
+    using node_type = typename node_traits::node_type;
+
+    enum { bulk_lanes = 8 };
+
+    // walks allocated slots in slot order
+    class iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = typename coalesced_map_view::value_type;
+        using difference_type = ptrdiff_t;
+        using pointer = const value_type*;
+        using reference = const value_type&;
+
+        iterator() = default;
+        iterator(const node_type* node, const node_type* last)
+            : node_(node), last_(last) {
+        }
+
+        iterator& operator++() {
+            do {
+                ++node_;
+            } while(node_ != last_ && !allocated_(node_));
+            return (*this);
+        }
+
+        reference operator*() const {
+            return node_->value;
+        }
+
+        pointer operator->() const {
+            return &node_->value;
+        }
+
+        bool operator!=(const iterator& rhs) const {
+            return (node_ != rhs.node_);
+        }
+
+        bool operator==(const iterator& rhs) const {
+            return !(*this != rhs);
+        }
+
+        const node_type* get_node() const {
+            return node_;
+        }
+
+    private:
+        const node_type* node_{nullptr};
+        const node_type* last_{nullptr};
+    };
+
+    coalesced_map_view() = default;
+
+    coalesced_map_view(const void* data, size_t size) {
+        attach(data, size);
+    }
+
+    // false (and an empty view) when data is no compatible image for the
+    // view (see Image format), reads the header only
+    bool attach(
+        const void* data, size_t size, uint64_t* log_sequence = nullptr) {
+        *this = coalesced_map_view();
+        ch_image_header_t header;
+        if(data == nullptr || size < sizeof(header))
+            return false;
+        std::memcpy(&header, data, sizeof(header));
+        auto table = static_cast<const char*>(data) + sizeof(header);
+        auto table_bytes = sizeof(node_type) * (uint64_t(header.capacity) + 1);
+        if(!ch_image_compatible(
+               header,
+               ch_image_signature<Key, Hasher, node_type, GrowthPolicy>())
+           || size - sizeof(header) != table_bytes
+           || reinterpret_cast<uintptr_t>(table) % alignof(node_type) != 0
+           || header.capacity > HeaderTraits::max_capacity)
+            return false;
+        table_ = reinterpret_cast<const node_type*>(table);
+        capacity_ = header.capacity;
+        address_region_ = header.address_region;
+        size_ = header.size;
+        checksum_ = header.checksum;
+        if(log_sequence != nullptr)
+            *log_sequence = header.log_sequence;
+        return true;
+    }
+
+    // checksum of the attached table, reads the whole buffer
+    bool verify() const {
+        return table_ != nullptr
+            && checksum_
+            == ch_image_checksum(
+                   table_, sizeof(node_type) * (uint64_t(capacity_) + 1));
+    }
+
+    /** Warm-up
+     * Advises the kernel to read ahead the whole buffer (when it is mmap'ed,
+     * mapping with MAP_POPULATE does the same up front), then touches
+     * every page on threads workers. Returns the time taken. */
+    std::chrono::nanoseconds warm(unsigned threads = 1) const {
+        auto start = std::chrono::steady_clock::now();
+        if(table_ == nullptr)
+            return std::chrono::nanoseconds(0);
+        ch_memory_region_t region{
+            table_, sizeof(node_type) * (size_t(capacity_) + 1)};
+#if defined(__unix__) || defined(__APPLE__)
+        // madvise wants a page aligned start, anonymous memory ignores it
+        auto first = reinterpret_cast<uintptr_t>(region.data);
+        auto aligned = first & ~uintptr_t(ch_touch_page_bytes - 1);
+        ::madvise(
+            reinterpret_cast<void*>(aligned), region.size + (first - aligned),
+            MADV_WILLNEED);
+#endif
+        ch_touch_pages(&region, 1, threads);
+        return std::chrono::steady_clock::now() - start;
+    }
+
+    bool attached() const {
+        return (table_ != nullptr);
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return (size_ == 0);
+    }
+
+    uint32_t bucket_count() const {
+        return capacity_;
+    }
+
+    [[nodiscard]] iterator begin() const {
+        if(table_ == nullptr)
+            return end();
+        iterator first(table_, table_ + capacity_);
+        if(allocated_(table_))
+            return first;
+        return ++first;
+    }
+
+    [[nodiscard]] iterator end() const {
+        return iterator(table_ + capacity_, table_ + capacity_);
+    }
+
+    [[nodiscard]] iterator find(const key_type& key) const {
+        if(table_ == nullptr)
+            return end();
+        uint32_t slot = get_slot_(key);
+        find_lanes_(&key, &slot, 1);
+        return iterator(table_ + slot, table_ + capacity_);
+    }
+
+    bool contains(const key_type& key) const {
+        return (find(key) != end());
+    }
+
+    // out[i] receives find(keys[i]), chain walks of bulk_lanes keys are
+    // interleaved so their cache misses overlap
+    void find_bulk(const key_type* keys, size_t count, iterator* out) const {
+        if(table_ == nullptr) {
+            std::fill(out, out + count, end());
+            return;
+        }
+        uint32_t slots[bulk_lanes];
+        for(size_t i = 0; i < count; i += bulk_lanes) {
+            auto lanes = static_cast<uint32_t>(
+                std::min<size_t>(bulk_lanes, count - i));
+            for(uint32_t j = 0; j < lanes; ++j)
+                slots[j] = get_slot_(keys[i + j]);
+            find_lanes_(keys + i, slots, lanes);
+            for(uint32_t j = 0; j < lanes; ++j)
+                out[i + j] = iterator(table_ + slots[j], table_ + capacity_);
+        }
+    }
+
+private:
+    // header traits take mutable nodes but only read them here
+    static bool allocated_(const node_type* node) {
+        return node_traits::is_allocated(const_cast<node_type*>(node));
+    }
+
+    uint32_t get_slot_(const key_type& key) const {
+        return GrowthPolicy::bucket(hasher{}(key), address_region_);
+    }
+
+    // replaces home slots with slots of found nodes, misses get capacity_
+    void find_lanes_(
+        const key_type* keys, uint32_t* slots, uint32_t lanes) const {
+        // every lane takes one hop per round, a chain longer than the
+        // table is a cycle
+        uint32_t rounds = 0;
+        uint32_t active = 0;
+        for(uint32_t j = 0; j < lanes; ++j) {
+            if(allocated_(table_ + slots[j]))
+                active |= 1u << j;
+            else
+                slots[j] = capacity_;
+        }
+        while(active != 0) {
+            if(rounds++ == capacity_) {
+                for(uint32_t j = 0; j < lanes; ++j) {
+                    if(active & (1u << j))
+                        slots[j] = capacity_;
+                }
+                break;
+            }
+            for(uint32_t j = 0; j < lanes; ++j) {
+                if(0 == (active & (1u << j)))
+                    continue;
+                auto node = const_cast<node_type*>(table_ + slots[j]);
+                if(key_equal()(node_traits::key(node), keys[j])) {
+                    active &= ~(1u << j);
+                    continue;
+                }
+                auto next = node_traits::next(node);
+                if(node_traits::is_tail(node) || next >= capacity_) {
+                    slots[j] = capacity_;
+                    active &= ~(1u << j);
+                }
+                else {
+                    slots[j] = next;
+                }
+            }
+        }
+    }
+
+    const node_type* table_{nullptr};
+    uint32_t capacity_{0};
+    uint32_t address_region_{0};
+    uint32_t size_{0};
+    uint64_t checksum_{0};
+};
+
+} // namespace coalesced_hash